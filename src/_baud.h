@@ -0,0 +1,45 @@
+/**
+ *
+ * libUART
+ *
+ * Easy to use library for accessing the UART
+ *
+ * Copyright (c) 2025 Johannes Krottmayer <krotti83@proton.me>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef _LIBUART_INTERNAL_BAUD_H
+#define _LIBUART_INTERNAL_BAUD_H
+
+#include <stddef.h>
+
+/**
+ * Apply the line settings with an arbitrary baud rate (Linux termios2),
+ * optionally after all pending output was transmitted
+ *
+ * Separate translation unit, because the kernel termios definitions
+ * collide with the ones from the C library.
+ */
+extern int baud_set_custom(int fd,
+                           unsigned int iflag,
+                           unsigned int oflag,
+                           unsigned int cflag,
+                           unsigned int lflag,
+                           const unsigned char *cc,
+                           size_t ncc,
+                           int baud,
+                           int drain);
+
+#endif
@@ -33,4 +33,13 @@ extern int _uart_thread_lock_tx(struct _uart_ctx *ctx, struct _uart *uart);
 extern int _uart_thread_unlock_rx(struct _uart_ctx *ctx, struct _uart *uart);
 extern int _uart_thread_unlock_tx(struct _uart_ctx *ctx, struct _uart *uart);
 
+#ifdef __unix__
+extern int _uart_thread_pause_tx(struct _uart_ctx *ctx, struct _uart *uart, int timeout);
+extern int _uart_thread_wait_tx(struct _uart_ctx *ctx, struct _uart *uart, long long deadline);
+extern int _uart_thread_pin_start(struct _uart_ctx *ctx, struct _uart *uart);
+extern int _uart_thread_pin_stop(struct _uart_ctx *ctx, struct _uart *uart);
+extern int _uart_thread_pin_signal(struct _uart_ctx *ctx, int signum);
+extern void _uart_thread_open_many(struct _uart_ctx *ctx, struct _uart **uarts, int *rets, int count);
+#endif
+
 #endif
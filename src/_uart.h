@@ -26,6 +26,7 @@
 #ifdef _WIN32
 #include <windows.h>
 #else
+#include <termios.h>
 #ifdef LIBUART_THREADS
 #include <pthread.h>
 #endif
@@ -35,20 +36,56 @@
 #include "_buffer.h"
 
 #define UART_BUFFERSIZE         1048576
+#define UART_ECHOSIZE           65536
+#define UART_ECHORECMAX         64
+
+/* transmitted bytes expected back until end (ms) plus a margin */
+struct _uart_echo {
+    ssize_t len;
+    long long end;
+};
 #endif
 
 #include <UART.h>
 
 #define UART_NAMEMAX            512
 #define UART_ERRORMAX           512
+#define UART_RXERRMAX           256
+#define UART_FLUSHTIMEOUT       1000
+#define UART_ADDRTIMEOUT        1000
 
 #define UART_FOPENED            0x00000001
+#define UART_FGONE              0x00000002
+#define UART_FSCANNED           0x00000004
+#define UART_FPENDING           0x00000008
+#define UART_FINFO              0x00000010
 #define UART_FERROR             0x80000000
 
 struct _uart {
     char dev[UART_NAMEMAX];
+    struct uart_dev_info info;
 #ifdef __unix__
     int fd;
+    char lock[UART_NAMEMAX];
+    int owner;
+    struct termios tio;
+    struct uart_counters counters;
+    struct uart_rs485 rs485;
+    struct uart_flow_stats flow;
+    long long flow_since;
+    int flow_pending;
+    int md_addr;
+    int md_selected;
+    enum e_data md_data_bits;
+    enum e_parity md_parity;
+    tcflag_t md_iflag;
+    int rx_esc;
+    int rx_errors;
+    unsigned long long rx_offset;
+    struct uart_rx_error *rx_err;
+    int rx_err_head;
+    int rx_err_num;
+    unsigned long rx_err_lost;
 #elif _WIN32
     HANDLE h;
     COMMPROP prop;
@@ -58,6 +95,7 @@ struct _uart {
     enum e_stop stop_bits;
     enum e_parity parity;
     enum e_flow flow_ctrl;
+    int exclusive;
     int error;
     char *errormsg;
     unsigned int flags;
@@ -71,6 +109,29 @@ struct _uart {
     int tx_thread_run;
     pthread_mutex_t rx_lock;
     pthread_mutex_t tx_lock;
+    pthread_cond_t tx_cond;
+    void *thread_args;
+    pthread_t pin_thread;
+    pthread_mutex_t pin_mutex;
+    int pin_thread_started;
+    int pin_thread_run;
+    int pin_thread_stop;
+    int pin_event;
+    int pin_mask;
+    uart_pin_cb pin_cb;
+    void *pin_arg;
+    pthread_mutex_t echo_lock;
+    buffer_t *echo_buffer;
+    struct _uart_echo echo_rec[UART_ECHORECMAX];
+    int echo_rec_head;
+    int echo_rec_num;
+    int echo;
+    unsigned long collisions;
+    pthread_mutex_t link_lock;
+    struct uart_reconnect reconnect;
+    unsigned long link_gen;
+    int link_state;
+    unsigned long reconnects;
 #elif _WIN32
     HANDLE rx_thread;
     HANDLE tx_thread;
@@ -86,9 +147,8 @@ struct _uart {
 #endif
 };
 
-#define UART_DEVMAX             512
-
 #define UART_CTXFOKAY           0x00000001
+#define UART_CTXFSCANNED        0x00000002
 #define UART_CTXFERROR          0x80000000
 
 struct _uart_ctx {
@@ -96,12 +156,60 @@ struct _uart_ctx {
     int error;
     char *errormsg;
     int uarts_count;
-    struct _uart *uarts[UART_DEVMAX];
+    int uarts_size;
+    struct _uart **uarts;
+    struct _uart **index;
+    unsigned int index_size;
     unsigned int flags;
+    char **scan;
+    int scan_count;
+    int scan_size;
+    char **added;
+    int added_count;
+    char **removed;
+    int removed_count;
+#ifdef __unix__
+    int hotplug_fd;
+    uart_hotplug_cb hotplug_cb;
+    void *hotplug_arg;
+#endif
 };
 
 extern int _uart_get_device_list(struct _uart_ctx *ctx);
 
+extern void _uart_get_device_info(struct _uart_ctx *ctx,
+                                  struct _uart **uarts,
+                                  int count);
+
+extern struct _uart *_uart_device_new(struct _uart_ctx *ctx,
+                                      const char *dev);
+
+extern int _uart_device_insert(struct _uart_ctx *ctx,
+                               struct _uart *uart);
+
+extern void _uart_device_remove(struct _uart_ctx *ctx,
+                                struct _uart *uart);
+
+extern struct _uart *_uart_device_lookup(struct _uart_ctx *ctx,
+                                         const char *dev);
+
+extern int _uart_device_found(struct _uart_ctx *ctx,
+                              const char *dev);
+
+extern int _uart_device_merge(struct _uart_ctx *ctx);
+
+extern void _uart_device_scan_reset(struct _uart_ctx *ctx);
+
+extern void _uart_device_free(struct _uart_ctx *ctx);
+
+#ifdef __unix__
+extern int _uart_hotplug_open(struct _uart_ctx *ctx);
+
+extern int _uart_hotplug_read(struct _uart_ctx *ctx);
+
+extern void _uart_hotplug_close(struct _uart_ctx *ctx);
+#endif
+
 extern int _uart_baud_valid(int value);
 
 extern int _uart_init_baud(struct _uart_ctx *ctx,
@@ -119,11 +227,28 @@ extern int _uart_init_stopbits(struct _uart_ctx *ctx,
 extern int _uart_init_flow(struct _uart_ctx *ctx,
                            struct _uart *uart);
 
+#ifdef __unix__
+extern int _uart_configure(struct _uart_ctx *ctx,
+                           struct _uart *uart,
+                           int drain);
+#endif
+
 extern int _uart_init(struct _uart_ctx *ctx);
 
+#ifdef __unix__
+extern int _uart_get_owner(struct _uart_ctx *ctx,
+                           const char *dev,
+                           int *pid);
+#endif
+
 extern int _uart_open(struct _uart_ctx *ctx,
                       struct _uart *uart);
 
+#ifdef __unix__
+extern int _uart_reopen(struct _uart_ctx *ctx,
+                        struct _uart *uart);
+#endif
+
 extern int _uart_close(struct _uart_ctx *ctx,
                        struct _uart *uart);
 
@@ -137,11 +262,104 @@ extern ssize_t _uart_recv(struct _uart_ctx *ctx,
                           struct _uart *uart,
                           void *recv_buf,
                           size_t len);
+
+#ifdef __unix__
+extern ssize_t _uart_send_timeout(struct _uart_ctx *ctx,
+                                  struct _uart *uart,
+                                  void *send_buf,
+                                  size_t len,
+                                  int timeout);
+
+extern ssize_t _uart_sendv(struct _uart_ctx *ctx,
+                           struct _uart *uart,
+                           const struct iovec *iov,
+                           int iovcnt);
+
+extern ssize_t _uart_recvv(struct _uart_ctx *ctx,
+                           struct _uart *uart,
+                           const struct iovec *iov,
+                           int iovcnt);
+#endif
 #endif
 
 extern int _uart_flush(struct _uart_ctx *ctx,
                        struct _uart *uart);
 
+#ifdef __unix__
+extern int _uart_drain(struct _uart_ctx *ctx,
+                       struct _uart *uart,
+                       int timeout);
+
+extern int _uart_drain_discard(struct _uart_ctx *ctx,
+                               struct _uart *uart,
+                               int timeout);
+
+extern int _uart_get_queue(struct _uart_ctx *ctx,
+                           struct _uart *uart,
+                           int *in,
+                           int *out);
+#endif
+
+#ifdef __unix__
+extern int _uart_get_counters(struct _uart_ctx *ctx,
+                              struct _uart *uart,
+                              struct uart_counters *counters);
+#endif
+
+#ifdef __unix__
+extern int _uart_set_multidrop(struct _uart_ctx *ctx,
+                               struct _uart *uart,
+                               int address);
+
+extern int _uart_send_address(struct _uart_ctx *ctx,
+                              struct _uart *uart,
+                              unsigned char address);
+
+extern int _uart_set_rx_errors(struct _uart_ctx *ctx,
+                               struct _uart *uart,
+                               int mask);
+
+extern int _uart_send_break(struct _uart_ctx *ctx,
+                            struct _uart *uart,
+                            int duration);
+
+extern int _uart_get_rx_errors(struct _uart *uart,
+                               struct uart_rx_error *errors,
+                               int max,
+                               unsigned long *lost);
+
+extern ssize_t _uart_parmrk_filter(struct _uart *uart,
+                                   unsigned char *data,
+                                   ssize_t len);
+
+extern void _uart_rx_error_skip(struct _uart *uart,
+                                ssize_t skip);
+#endif
+
+#ifdef __unix__
+extern int _uart_flow_update(struct _uart_ctx *ctx,
+                             struct _uart *uart,
+                             int pending);
+#endif
+
+#ifdef __unix__
+extern int _uart_set_latency(struct _uart_ctx *ctx,
+                             struct _uart *uart,
+                             const struct uart_latency *lat);
+#endif
+
+#ifdef __unix__
+extern int _uart_set_rs485(struct _uart_ctx *ctx,
+                           struct _uart *uart,
+                           const struct uart_rs485 *conf);
+
+extern int _uart_rs485_begin(struct _uart_ctx *ctx,
+                             struct _uart *uart);
+
+extern int _uart_rs485_end(struct _uart_ctx *ctx,
+                           struct _uart *uart);
+#endif
+
 extern int _uart_set_pin(struct _uart_ctx *ctx,
                          struct _uart *uart,
                          enum e_pins pin,
@@ -152,6 +370,13 @@ extern int _uart_get_pin(struct _uart_ctx *ctx,
                          enum e_pins pin,
                          int *state);
 
+#ifdef __unix__
+extern int _uart_set_pins(struct _uart_ctx *ctx,
+                          struct _uart *uart,
+                          int set,
+                          int clear);
+#endif
+
 #ifndef LIBUART_THREADS
 extern int _uart_get_bytes(struct _uart_ctx *ctx,
                            struct _uart *uart,
@@ -32,5 +32,6 @@
 
 extern int enum_contains(int enum_values[], int len, int value);
 extern int strnrcmp(const char *str1, const char *str2, size_t num);
+extern long long time_get_ms(void);
 
 #endif
@@ -22,6 +22,7 @@
 
 #include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "_buffer.h"
 
@@ -164,6 +165,65 @@ ssize_t buffer_rd(buffer_t *buf, void *data, ssize_t len)
     return len;
 }
 
+ssize_t buffer_peek(buffer_t *buf, void *data, ssize_t len)
+{
+    ssize_t n;
+    unsigned char *src;
+    unsigned char *dst;
+
+    if (!buf) {
+        return BUFFER_EINVAL;
+    }
+
+    if (!data) {
+        return BUFFER_EINVAL;
+    }
+
+    if (len > buf->b_num) {
+        return BUFFER_ERANGE;
+    }
+
+    if (len < 1) {
+        return 0;
+    }
+
+    src = (unsigned char *) buf->b_p;
+    dst = (unsigned char *) data;
+
+    /* copy the data up to the end of the buffer, then the wrapped part */
+    n = buf->b_len - buf->b_idxr;
+
+    if (n > len)
+        n = len;
+
+    memcpy(dst, &src[buf->b_idxr], n);
+
+    if (n < len)
+        memcpy(&dst[n], src, len - n);
+
+    return len;
+}
+
+ssize_t buffer_skip(buffer_t *buf, ssize_t len)
+{
+    if (!buf) {
+        return BUFFER_EINVAL;
+    }
+
+    if (len > buf->b_num) {
+        return BUFFER_ERANGE;
+    }
+
+    if (len < 1) {
+        return 0;
+    }
+
+    buf->b_num -= len;
+    buf->b_idxr = (buf->b_idxr + len) % buf->b_len;
+
+    return len;
+}
+
 ssize_t buffer_get_len(buffer_t *buf)
 {
     if (!buf) {
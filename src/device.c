@@ -0,0 +1,533 @@
+/**
+ *
+ * libUART
+ *
+ * Easy to use library for accessing the UART
+ *
+ * Copyright (c) 2025 Johannes Krottmayer <krotti83@proton.me>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __unix__
+#include <limits.h>
+#endif
+
+#include "_uart.h"
+
+#include <UART.h>
+
+#define UART_INDEXMIN           64
+
+static char *str_dup(const char *str)
+{
+    size_t len = strlen(str) + 1;
+    char *p;
+
+    p = (char *) malloc(len);
+
+    if (p) {
+        memcpy(p, str, len);
+    }
+
+    return p;
+}
+
+static int name_cmp(const void *a, const void *b)
+{
+    return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+static int uart_cmp(const void *a, const void *b)
+{
+    return strcmp((*(struct _uart * const *) a)->dev, (*(struct _uart * const *) b)->dev);
+}
+
+static void names_free(char **names, int count)
+{
+    int i;
+
+    for (i = 0; i < count; i++) {
+        free(names[i]);
+    }
+
+    free(names);
+}
+
+/**
+ * FNV-1a hash of a device path
+ */
+static unsigned int name_hash(const char *str)
+{
+    unsigned int hash = 2166136261u;
+
+    while (*str) {
+        hash ^= (unsigned char) *str++;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+static void index_add(struct _uart_ctx *ctx, struct _uart *uart)
+{
+    unsigned int mask = ctx->index_size - 1;
+    unsigned int i = name_hash(uart->dev) & mask;
+
+    while (ctx->index[i]) {
+        i = (i + 1) & mask;
+    }
+
+    ctx->index[i] = uart;
+}
+
+/**
+ * Allocate a device path index for count devices (open addressing, at
+ * most half full)
+ */
+static struct _uart **index_alloc(struct _uart_ctx *ctx, int count, unsigned int *ret_size)
+{
+    struct _uart **index;
+    unsigned int size = UART_INDEXMIN;
+
+    while (size < (unsigned int) count * 2) {
+        size *= 2;
+    }
+
+    index = (struct _uart **) calloc(size, sizeof(struct _uart *));
+
+    if (!index) {
+        _uart_error(ctx, NULL, UART_ENOMEM, NULL, NULL);
+
+        return NULL;
+    }
+
+    *(ret_size) = size;
+
+    return index;
+}
+
+/**
+ * Replace the index with a new (empty) one and add all devices
+ */
+static void index_install(struct _uart_ctx *ctx, struct _uart **index, unsigned int size)
+{
+    int i;
+
+    free(ctx->index);
+    ctx->index = index;
+    ctx->index_size = size;
+
+    for (i = 0; i < ctx->uarts_count; i++) {
+        index_add(ctx, ctx->uarts[i]);
+    }
+}
+
+static int index_rebuild(struct _uart_ctx *ctx)
+{
+    struct _uart **index;
+    unsigned int size;
+
+    index = index_alloc(ctx, ctx->uarts_count, &size);
+
+    if (!index) {
+        return UART_ENOMEM;
+    }
+
+    index_install(ctx, index, size);
+
+    return UART_ESUCCESS;
+}
+
+static struct _uart *index_find(struct _uart_ctx *ctx, const char *dev)
+{
+    unsigned int mask;
+    unsigned int i;
+
+    if (!ctx->index) {
+        return NULL;
+    }
+
+    mask = ctx->index_size - 1;
+    i = name_hash(dev) & mask;
+
+    while (ctx->index[i]) {
+        if (strcmp(ctx->index[i]->dev, dev) == 0) {
+            return ctx->index[i];
+        }
+
+        i = (i + 1) & mask;
+    }
+
+    return NULL;
+}
+
+struct _uart *_uart_device_new(struct _uart_ctx *ctx, const char *dev)
+{
+    struct _uart *uart;
+
+    uart = (struct _uart *) malloc(sizeof(struct _uart));
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_ENOMEM, NULL, NULL);
+
+        return NULL;
+    }
+
+    memset(uart, 0, sizeof(struct _uart));
+    uart->errormsg = (char *) malloc(UART_ERRORMAX);
+
+    if (!uart->errormsg) {
+        free(uart);
+        _uart_error(ctx, NULL, UART_ENOMEM, NULL, NULL);
+
+        return NULL;
+    }
+
+    uart->errormsg[0] = '\0';
+    strncpy(uart->dev, dev, UART_NAMEMAX - 1);
+    uart->dev[UART_NAMEMAX - 1] = '\0';
+
+    return uart;
+}
+
+int _uart_device_insert(struct _uart_ctx *ctx, struct _uart *uart)
+{
+    struct _uart **tmp;
+    int size;
+
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (ctx->uarts_count == ctx->uarts_size) {
+        size = (ctx->uarts_size) ? ctx->uarts_size * 2 : 64;
+        tmp = (struct _uart **) realloc(ctx->uarts, (size_t) size * sizeof(struct _uart *));
+
+        if (!tmp) {
+            _uart_error(ctx, NULL, UART_ENOMEM, NULL, NULL);
+
+            return UART_ENOMEM;
+        }
+
+        ctx->uarts = tmp;
+        ctx->uarts_size = size;
+    }
+
+    ctx->uarts[ctx->uarts_count++] = uart;
+
+    if ((unsigned int) ctx->uarts_count * 2 > ctx->index_size) {
+        if (index_rebuild(ctx) != UART_ESUCCESS) {
+            ctx->uarts_count--;
+
+            return UART_ENOMEM;
+        }
+    } else {
+        index_add(ctx, uart);
+    }
+
+    return UART_ESUCCESS;
+}
+
+void _uart_device_remove(struct _uart_ctx *ctx, struct _uart *uart)
+{
+    unsigned int mask;
+    unsigned int i;
+    unsigned int j;
+    unsigned int k;
+    int n;
+
+    for (n = 0; n < ctx->uarts_count; n++) {
+        if (ctx->uarts[n] == uart) {
+            memmove(&ctx->uarts[n], &ctx->uarts[n + 1],
+                    (size_t) (ctx->uarts_count - n - 1) * sizeof(struct _uart *));
+            ctx->uarts_count--;
+
+            break;
+        }
+    }
+
+    if (!ctx->index) {
+        return;
+    }
+
+    mask = ctx->index_size - 1;
+    i = name_hash(uart->dev) & mask;
+
+    while (ctx->index[i] && (ctx->index[i] != uart)) {
+        i = (i + 1) & mask;
+    }
+
+    if (!ctx->index[i]) {
+        return;
+    }
+
+    /* backward shift deletion keeps the probe chains intact */
+    ctx->index[i] = NULL;
+    j = i;
+
+    for (;;) {
+        j = (j + 1) & mask;
+
+        if (!ctx->index[j]) {
+            break;
+        }
+
+        k = name_hash(ctx->index[j]->dev) & mask;
+
+        if ((i <= j) ? ((i < k) && (k <= j)) : ((i < k) || (k <= j))) {
+            continue;
+        }
+
+        ctx->index[i] = ctx->index[j];
+        ctx->index[j] = NULL;
+        i = j;
+    }
+}
+
+struct _uart *_uart_device_lookup(struct _uart_ctx *ctx, const char *dev)
+{
+    struct _uart *uart;
+#ifdef __unix__
+    char path[PATH_MAX];
+#endif
+
+    uart = index_find(ctx, dev);
+
+#ifdef __unix__
+    /* stable names (e.g. '/dev/serial/by-id') link to the enumerated tty */
+    if (!uart && realpath(dev, path) && (strcmp(path, dev) != 0)) {
+        uart = index_find(ctx, path);
+    }
+#endif
+
+    return uart;
+}
+
+int _uart_device_found(struct _uart_ctx *ctx, const char *dev)
+{
+    char **tmp;
+    int size;
+
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (ctx->scan_count == ctx->scan_size) {
+        size = (ctx->scan_size) ? ctx->scan_size * 2 : 64;
+        tmp = (char **) realloc(ctx->scan, (size_t) size * sizeof(char *));
+
+        if (!tmp) {
+            _uart_error(ctx, NULL, UART_ENOMEM, NULL, NULL);
+
+            return UART_ENOMEM;
+        }
+
+        ctx->scan = tmp;
+        ctx->scan_size = size;
+    }
+
+    ctx->scan[ctx->scan_count] = str_dup(dev);
+
+    if (!ctx->scan[ctx->scan_count]) {
+        _uart_error(ctx, NULL, UART_ENOMEM, NULL, NULL);
+
+        return UART_ENOMEM;
+    }
+
+    ctx->scan_count++;
+
+    return UART_ESUCCESS;
+}
+
+void _uart_device_scan_reset(struct _uart_ctx *ctx)
+{
+    int i;
+
+    for (i = 0; i < ctx->scan_count; i++) {
+        free(ctx->scan[i]);
+    }
+
+    ctx->scan_count = 0;
+}
+
+void _uart_device_free(struct _uart_ctx *ctx)
+{
+    _uart_device_scan_reset(ctx);
+    free(ctx->scan);
+    ctx->scan = NULL;
+    ctx->scan_size = 0;
+    names_free(ctx->added, ctx->added_count);
+    names_free(ctx->removed, ctx->removed_count);
+    ctx->added = NULL;
+    ctx->added_count = 0;
+    ctx->removed = NULL;
+    ctx->removed_count = 0;
+    free(ctx->uarts);
+    ctx->uarts = NULL;
+    ctx->uarts_count = 0;
+    ctx->uarts_size = 0;
+    free(ctx->index);
+    ctx->index = NULL;
+    ctx->index_size = 0;
+}
+
+int _uart_device_merge(struct _uart_ctx *ctx)
+{
+    struct _uart **table;
+    struct _uart **index;
+    struct _uart *uart;
+    char **added;
+    char **removed;
+    int size;
+    unsigned int index_size = 0;
+    int count = 0;
+    int i = 0;
+    int j = 0;
+    int cmp;
+    int ret = UART_ESUCCESS;
+    const char *last = NULL;
+
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    added = (char **) malloc((size_t) (ctx->scan_count + 1) * sizeof(char *));
+    removed = (char **) malloc((size_t) (ctx->uarts_count + 1) * sizeof(char *));
+    size = ctx->uarts_count + ctx->scan_count + 1;
+    table = (struct _uart **) malloc((size_t) size * sizeof(struct _uart *));
+
+    /**
+     * The new index is allocated before any entry is freed, the old one
+     * must never be left pointing to removed devices.
+     */
+    index = index_alloc(ctx, size, &index_size);
+
+    if (!added || !removed || !table || !index) {
+        free(added);
+        free(removed);
+        free(table);
+        free(index);
+        _uart_device_scan_reset(ctx);
+        _uart_error(ctx, NULL, UART_ENOMEM, NULL, NULL);
+
+        return UART_ENOMEM;
+    }
+
+    names_free(ctx->added, ctx->added_count);
+    names_free(ctx->removed, ctx->removed_count);
+    ctx->added = added;
+    ctx->added_count = 0;
+    ctx->removed = removed;
+    ctx->removed_count = 0;
+
+    /**
+     * Both lists sorted by device path, so a single merge pass finds
+     * the unchanged, added and removed devices. Existing entries (and
+     * the handles the application holds) are kept.
+     */
+    qsort(ctx->scan, (size_t) ctx->scan_count, sizeof(char *), name_cmp);
+    qsort(ctx->uarts, (size_t) ctx->uarts_count, sizeof(struct _uart *), uart_cmp);
+
+    while ((i < ctx->uarts_count) || (j < ctx->scan_count)) {
+        /* a device may be reported twice */
+        if ((j < ctx->scan_count) && last && (strcmp(ctx->scan[j], last) == 0)) {
+            free(ctx->scan[j]);
+            ctx->scan[j] = NULL;
+            j++;
+
+            continue;
+        }
+
+        if (i >= ctx->uarts_count) {
+            cmp = 1;
+        } else if (j >= ctx->scan_count) {
+            cmp = -1;
+        } else {
+            cmp = strcmp(ctx->uarts[i]->dev, ctx->scan[j]);
+        }
+
+        if (cmp == 0) {
+            last = ctx->scan[j];
+            uart = ctx->uarts[i++];
+            uart->flags |= UART_FSCANNED;
+
+            /* an opened device which was gone is back */
+            if (uart->flags & UART_FGONE) {
+                uart->flags &= ~(UART_FGONE | UART_FINFO);
+                ctx->added[ctx->added_count++] = ctx->scan[j];
+                ctx->scan[j] = NULL;
+            }
+
+            table[count++] = uart;
+            j++;
+        } else if (cmp < 0) {
+            uart = ctx->uarts[i++];
+
+            /**
+             * Only enumerated devices are reported as removed (once),
+             * devices opened by name are never part of a scan.
+             */
+            if ((uart->flags & UART_FSCANNED) && !(uart->flags & UART_FGONE)) {
+                ctx->removed[ctx->removed_count] = str_dup(uart->dev);
+
+                if (ctx->removed[ctx->removed_count]) {
+                    ctx->removed_count++;
+                }
+            }
+
+            /* opened devices stay until they are closed */
+            if (uart->flags & UART_FOPENED) {
+                if (uart->flags & UART_FSCANNED) {
+                    uart->flags |= UART_FGONE;
+                }
+
+                table[count++] = uart;
+            } else {
+                free(uart->errormsg);
+                free(uart);
+            }
+        } else {
+            last = ctx->scan[j];
+            uart = _uart_device_new(ctx, ctx->scan[j]);
+
+            if (!uart) {
+                ret = UART_ENOMEM;
+                j++;
+
+                continue;
+            }
+
+            uart->flags |= UART_FSCANNED;
+            table[count++] = uart;
+
+            /* the name moves from the scan to the added list */
+            ctx->added[ctx->added_count++] = ctx->scan[j];
+            ctx->scan[j] = NULL;
+            j++;
+        }
+    }
+
+    free(ctx->uarts);
+    ctx->uarts = table;
+    ctx->uarts_count = count;
+    ctx->uarts_size = size;
+    _uart_device_scan_reset(ctx);
+    index_install(ctx, index, index_size);
+
+    return ret;
+}
@@ -21,27 +21,38 @@
 LIBUART_DIR				= ./src
 
 ifneq ($(CONFIG_BUILD_OS),win32)
+LIBUART_SCSRC				+= $(BUILD_DIR)/static/device.c
 LIBUART_SCSRC				+= $(BUILD_DIR)/static/posix_error.c
 LIBUART_SCSRC				+= $(BUILD_DIR)/static/posix_uart.c
 LIBUART_SCSRC				+= $(BUILD_DIR)/static/uart.c
 LIBUART_SCSRC				+= $(BUILD_DIR)/static/util.c
 
+ifeq ($(CONFIG_BUILD_OS),linux)
+LIBUART_SCSRC				+= $(BUILD_DIR)/static/linux_baud.c
+endif
+
 ifeq ($(CONFIG_BUILD_THREADS),yes)
 LIBUART_SCSRC				+= $(BUILD_DIR)/static/buffer.c
 LIBUART_SCSRC				+= $(BUILD_DIR)/static/posix_thread.c
 endif
 
+LIBUART_DCSRC				+= $(BUILD_DIR)/dynamic/device.c
 LIBUART_DCSRC				+= $(BUILD_DIR)/dynamic/posix_error.c
 LIBUART_DCSRC				+= $(BUILD_DIR)/dynamic/posix_uart.c
 LIBUART_DCSRC				+= $(BUILD_DIR)/dynamic/uart.c
 LIBUART_DCSRC				+= $(BUILD_DIR)/dynamic/util.c
 
+ifeq ($(CONFIG_BUILD_OS),linux)
+LIBUART_DCSRC				+= $(BUILD_DIR)/dynamic/linux_baud.c
+endif
+
 ifeq ($(CONFIG_BUILD_THREADS),yes)
 LIBUART_DCSRC				+= $(BUILD_DIR)/dynamic/buffer.c
 LIBUART_DCSRC				+= $(BUILD_DIR)/dynamic/posix_thread.c
 endif
 
 else
+LIBUART_DCSRC				+= $(BUILD_DIR)/dynamic/device.c
 LIBUART_DCSRC				+= $(BUILD_DIR)/dynamic/win32_error.c
 LIBUART_DCSRC				+= $(BUILD_DIR)/dynamic/win32_uart.c
 LIBUART_DCSRC				+= $(BUILD_DIR)/dynamic/uart.c
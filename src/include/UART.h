@@ -34,6 +34,7 @@
 #endif
 #else
 #include <sys/types.h>
+#include <sys/uio.h>
 #endif
 
 /**
@@ -55,6 +56,9 @@
 #define UART_EHANDLE        (-13)   /* Invalid UART object/handle */
 #define UART_ECTX           (-14)   /* Invalid context */
 #define UART_EBUF           (-15)   /* Buffer full or empty (only with threading support) */
+#define UART_ETIMEOUT       (-16)   /* Operation timed out */
+#define UART_ENOTSUP        (-17)   /* Operation not supported */
+#define UART_EBUSY          (-18)   /* Device in use by another process */
 
 struct _uart_ctx;
 typedef struct _uart_ctx uart_ctx_t;
@@ -64,6 +68,9 @@ typedef struct _uart uart_t;
 
 /**
  * UART (default) baud rates
+ *
+ * On Linux any other positive baud rate can be passed as well, e.g.
+ * (enum e_baud) 250000, it's applied with termios2 (BOTHER).
  */
 enum e_baud {
 #ifdef __unix__
@@ -134,7 +141,9 @@ enum e_data {
 enum e_parity {
     UART_PARITY_NONE,       /* None */
     UART_PARITY_ODD,        /* Odd parity */
-    UART_PARITY_EVEN        /* Even parity */
+    UART_PARITY_EVEN,       /* Even parity */
+    UART_PARITY_MARK,       /* Parity bit always 1 */
+    UART_PARITY_SPACE       /* Parity bit always 0 */
 };
 
 /**
@@ -171,6 +180,197 @@ enum e_pins {
 #define UART_PIN_LOW        0
 #define UART_PIN_HIGH       1
 
+/* UART pin mask (multiple pins) */
+#define UART_PIN_MASK(pin)  (1 << (pin))
+
+/**
+ * UART pin change callback
+ *
+ * Called from a worker thread with the current input pin states and the
+ * changed pins (both pin masks) and a monotonic timestamp in ms.
+ */
+typedef void (*uart_pin_cb)(uart_t *uart, int state, int changed, long long timestamp, void *arg);
+
+/**
+ * UART pin sequence step
+ *
+ * Output pins in set are driven high, pins in clear are driven low (both
+ * pin masks), then the sequence waits delay ms before the next step.
+ */
+struct uart_pin_step {
+    int set;
+    int clear;
+    int delay;
+};
+
+/* UART RS-485 flags */
+#define UART_RS485_ENABLED          0x01    /* RS-485 mode enabled */
+#define UART_RS485_RTS_ON_SEND      0x02    /* RTS level while sending */
+#define UART_RS485_RTS_AFTER_SEND   0x04    /* RTS level after sending */
+#define UART_RS485_RX_DURING_TX     0x08    /* Receive while sending (kernel only) */
+#define UART_RS485_SOFTWARE         0x10    /* RTS toggled by libUART instead of the driver */
+
+/**
+ * UART RS-485 configuration
+ *
+ * Delays are in ms. If the driver has no RS-485 support (or
+ * UART_RS485_SOFTWARE is requested), RTS is switched by the send
+ * functions and released after the transmitter is empty.
+ */
+struct uart_rs485 {
+    int flags;
+    int delay_before;
+    int delay_after;
+};
+
+/* UART latency setting unchanged */
+#define UART_LATENCY_KEEP           (-1)
+
+/**
+ * UART latency profile
+ *
+ * Each member is applied only if not UART_LATENCY_KEEP.
+ */
+struct uart_latency {
+    int low_latency;        /* Driver low latency mode (ASYNC_LOW_LATENCY), 0 or 1 */
+    int rx_trigger;         /* RX FIFO trigger level in bytes (16550 rx_trig_bytes) */
+    int latency_timer;      /* USB-serial latency timer in ms (e.g. FTDI) */
+};
+
+/**
+ * UART hardware flow control statistics
+ */
+struct uart_flow_stats {
+    unsigned long stalls;       /* Number of times CTS stopped pending transmission */
+    long long blocked_ms;       /* Time the transmission was stopped by CTS in ms */
+    int blocked;                /* Transmission currently stopped by CTS */
+};
+
+/**
+ * UART reconnect policy
+ *
+ * After a read or write error the workers reopen the device, starting
+ * with delay_min ms between the attempts and doubling up to delay_max
+ * ms. max_tries limits the attempts (0 = unlimited). A pin change
+ * callback continues with the reopened device.
+ */
+struct uart_reconnect {
+    int enable;
+    int delay_min;
+    int delay_max;
+    int max_tries;
+};
+
+/* UART link states */
+#define UART_LINK_DOWN      0       /* Device failed, reconnecting */
+#define UART_LINK_UP        1       /* Device usable */
+#define UART_LINK_FAILED    2       /* Device failed, no reconnect (disabled or max_tries reached) */
+
+/* UART receive error kinds */
+#define UART_RXERR_CHAR     1       /* Character with parity or framing error */
+#define UART_RXERR_BREAK    2       /* Break condition */
+
+/**
+ * UART receive error record
+ *
+ * Errors are reported beside the data and not in-band, so the received
+ * data stays free of escapes for applications which don't collect them.
+ *
+ * The offset is the position in the received data, counted over all
+ * bytes returned by the receive functions since the device was opened
+ * (reconnects included, dropped echo and other stations' multidrop data
+ * excluded). An application counts the bytes it received the same way,
+ * a record belongs to the byte whose count equals the offset. Records
+ * can be collected before that byte was received (the RX worker decodes
+ * ahead with threading support), so keep records with a larger offset.
+ *
+ * A character with an error stays in the data at this offset, a break
+ * doesn't add a byte and has the offset of the byte following it.
+ */
+struct uart_rx_error {
+    unsigned long long offset;
+    int kind;
+    unsigned char data;
+};
+
+/**
+ * UART line counters
+ */
+struct uart_counters {
+    unsigned long rx;           /* Received characters */
+    unsigned long tx;           /* Transmitted characters */
+    unsigned long frame;        /* Framing errors */
+    unsigned long overrun;      /* Hardware (FIFO) overruns */
+    unsigned long parity;       /* Parity errors */
+    unsigned long brk;          /* Received breaks */
+    unsigned long buf_overrun;  /* Kernel buffer overruns */
+};
+
+/**
+ * UART device list changes
+ *
+ * Device names added and removed by the last scan, valid until the
+ * next scan.
+ */
+struct uart_dev_changes {
+    char **added;
+    int added_count;
+    char **removed;
+    int removed_count;
+};
+
+/* UART device info string size */
+#define UART_INFOMAX        256
+
+/* UART device info number unknown (or any value in UART_find_device) */
+#define UART_INFO_ANY       (-1)
+
+/**
+ * UART device identity
+ *
+ * Gathered once when a device is added to the device list. Empty
+ * strings and UART_INFO_ANY mark unknown values, and in UART_find_device
+ * they match any device.
+ */
+struct uart_dev_info {
+    char driver[UART_INFOMAX];      /* Kernel driver name */
+    int vid;                        /* USB vendor ID */
+    int pid;                        /* USB product ID */
+    char serial[UART_INFOMAX];      /* USB serial number */
+    int interface;                  /* USB interface number */
+    char by_id[UART_INFOMAX];       /* Stable link in '/dev/serial/by-id' */
+    char by_path[UART_INFOMAX];     /* Stable link in '/dev/serial/by-path' */
+};
+
+/**
+ * UART open request (UART_dev_open_many)
+ *
+ * The handle (NULL on failure) and the error code are returned in uart
+ * and error.
+ */
+struct uart_open_req {
+    const char *dev;
+    enum e_baud baud;
+    const char *opt;
+    uart_t *uart;
+    int error;
+};
+
+/* UART hotplug events */
+#define UART_HOTPLUG_ADD    1       /* Device appeared (or an opened device came back) */
+#define UART_HOTPLUG_REMOVE 2       /* Device disappeared */
+
+/**
+ * UART hotplug callback
+ *
+ * Called from UART_hotplug_dispatch after the device list was updated,
+ * once for each added or removed device name.
+ */
+typedef void (*uart_hotplug_cb)(uart_ctx_t *ctx, const char *dev, int event, void *arg);
+
+/* UART_init_ex flags */
+#define UART_INIT_LAZY      0x00000001  /* Enumerate devices on first UART_get_device_list call */
+
 #ifdef __unix__
 /**
  * libUART Basic Functions
@@ -179,15 +379,36 @@ enum e_pins {
 /* Create library context and initialize */
 extern int UART_init(uart_ctx_t **ret_ctx);
 
+/* Create library context and initialize with flags (UART_INIT_*) */
+extern int UART_init_ex(uart_ctx_t **ret_ctx, unsigned int flags);
+
 /* Free library context */
 extern int UART_free(uart_ctx_t *ctx);
 
-/* Return a list from all current available UART devices on system */
+/* Return a list from all current available UART devices on system (valid until the next scan or open) */
 extern ssize_t UART_get_device_list(uart_ctx_t *ctx, uart_t **ret_uarts);
 
-/* Opens an UART interface by device name */
+/* Rescan the UART devices and return the list and the changes since the last scan */
+extern ssize_t UART_update_device_list(uart_ctx_t *ctx, uart_t **ret_uarts, struct uart_dev_changes *ret_changes);
+
+/* Start watching for added and removed UART devices (returns a pollable fd in ret_fd) */
+extern int UART_hotplug_start(uart_ctx_t *ctx, uart_hotplug_cb cb, void *arg, int *ret_fd);
+
+/* Wait up to timeout ms (-1 = infinite) for hotplug events, update the device list and call the callback */
+extern int UART_hotplug_dispatch(uart_ctx_t *ctx, int timeout);
+
+/* Stop watching for added and removed UART devices */
+extern int UART_hotplug_stop(uart_ctx_t *ctx);
+
+/* Opens an UART interface by device name (opt e.g. "8N1N", append X for exclusive access) */
 extern uart_t *UART_dev_open_name(uart_ctx_t *ctx, const char *devname, enum e_baud baud, const char *opt);
 
+/* Opens multiple UART interfaces by device name concurrently (returns the number of opened interfaces) */
+extern int UART_dev_open_many(uart_ctx_t *ctx, struct uart_open_req *reqs, int count);
+
+/* Find the first UART device matching the given identity (enumerates devices if not done yet) */
+extern uart_t *UART_find_device(uart_ctx_t *ctx, const struct uart_dev_info *match);
+
 /* Opens an UART interface */
 extern int UART_dev_open(uart_ctx_t *ctx, uart_t *uart, enum e_baud baud, const char *opt);
 
@@ -207,6 +428,36 @@ extern ssize_t UART_send(uart_ctx_t *ctx, uart_t *uart, void *send_buf, size_t l
 /* Receive data from the UART interface */
 extern ssize_t UART_recv(uart_ctx_t *ctx, uart_t *uart, void *recv_buf, size_t len);
 
+/**
+ * Send all data over the UART interface or until the timeout (ms, -1 = infinite) expires,
+ * with LIBUART_THREADS the returned count are the bytes queued for the TX worker
+ */
+extern ssize_t UART_send_timeout(uart_ctx_t *ctx, uart_t *uart, void *send_buf, size_t len, int timeout);
+
+/* Send data from multiple buffers (scatter/gather) over the UART interface */
+extern ssize_t UART_sendv(uart_ctx_t *ctx, uart_t *uart, const struct iovec *iov, int iovcnt);
+
+/* Receive data into multiple buffers (scatter/gather) from the UART interface */
+extern ssize_t UART_recvv(uart_ctx_t *ctx, uart_t *uart, const struct iovec *iov, int iovcnt);
+
+/**
+ * Set 9-bit multidrop mode, only data after our address byte is received (address < 0 disables),
+ * changing the data bits or the parity fails with UART_EINVAL while it is enabled
+ */
+extern int UART_set_multidrop(uart_ctx_t *ctx, uart_t *uart, int address);
+
+/* Send a break after all queued data (duration in ms, 0 for the system default) */
+extern int UART_send_break(uart_ctx_t *ctx, uart_t *uart, int duration);
+
+/* Send an address byte (9th bit set) in multidrop mode */
+extern int UART_send_address(uart_ctx_t *ctx, uart_t *uart, unsigned char address);
+
+/* Enable receive error records (PARMRK) for the kinds in mask (UART_RXERR_*), 0 disables */
+extern int UART_set_rx_errors(uart_ctx_t *ctx, uart_t *uart, int mask);
+
+/* Get receive error records, returns the number of records (lost records since the last call optional) */
+extern int UART_get_rx_errors(uart_ctx_t *ctx, uart_t *uart, struct uart_rx_error *ret_errors, int max, unsigned long *ret_lost);
+
 /**
  * libUART Input/Output Functions
  */
@@ -223,16 +474,63 @@ extern int UART_getc(uart_ctx_t *ctx, uart_t *uart, char *ret_c);
 /* Flush not sent data from the UART interface */
 extern int UART_flush(uart_ctx_t *ctx, uart_t *uart);
 
+/* Wait until all data is transmitted or the timeout (ms, -1 = infinite) expires */
+extern int UART_drain(uart_ctx_t *ctx, uart_t *uart, int timeout);
+
 /* Set pin state from the UART interface */
 extern int UART_set_pin(uart_ctx_t *ctx, uart_t *uart, enum e_pins pin, int state);
 
 /* Get pin state from the UART interface */
 extern int UART_get_pin(uart_ctx_t *ctx, uart_t *uart, enum e_pins pin, int *ret_state);
 
+/* Set and clear multiple output pins at once (pin masks) */
+extern int UART_set_pins(uart_ctx_t *ctx, uart_t *uart, int set_mask, int clear_mask);
+
+/* Run a timed sequence of output pin states */
+extern int UART_set_pin_sequence(uart_ctx_t *ctx, uart_t *uart, const struct uart_pin_step *steps, int count);
+
+/* Set RS-485 mode (direction control with RTS) */
+extern int UART_set_rs485(uart_ctx_t *ctx, uart_t *uart, const struct uart_rs485 *conf);
+
+/* Get RS-485 mode (UART_RS485_SOFTWARE set if RTS is switched by libUART) */
+extern int UART_get_rs485(uart_ctx_t *ctx, uart_t *uart, struct uart_rs485 *ret_conf);
+
+/* Set callback for input pin changes (pin mask, NULL callback disables, only with threading support) */
+extern int UART_set_pin_callback(uart_ctx_t *ctx, uart_t *uart, int mask, uart_pin_cb cb, void *arg);
+
+/**
+ * Set the signal which interrupts the wait of the pin callback worker (0 = SIGRTMIN,
+ * SIGUSR1, SIGUSR2 or a realtime signal). The handler is only installed while a pin
+ * callback is set, other deliveries of the signal are passed to the previous handler.
+ * Fails with UART_EBUSY while a pin callback is set.
+ */
+extern int UART_set_pin_signal(uart_ctx_t *ctx, int signum);
+
+/* Drop the echo of transmitted data from received data (half-duplex, only with threading support) */
+extern int UART_set_echo_suppress(uart_ctx_t *ctx, uart_t *uart, int enable);
+
+/* Get number of collisions (received echo differed from transmitted data) */
+extern int UART_get_collisions(uart_ctx_t *ctx, uart_t *uart, unsigned long *ret_collisions);
+
+/* Reopen the device with the same configuration after an error, keeping buffered data (only with threading support) */
+extern int UART_set_reconnect(uart_ctx_t *ctx, uart_t *uart, const struct uart_reconnect *policy);
+
+/* Get the link state (UART_LINK_*) and the number of reconnects */
+extern int UART_get_link_state(uart_ctx_t *ctx, uart_t *uart, int *ret_state, unsigned long *ret_reconnects);
+
 /**
  * libUART Configuration Functions
  */
 
+/* Set baud rate and line options from the UART interface at once */
+extern int UART_configure(uart_ctx_t *ctx, uart_t *uart, enum e_baud baud, const char *opt);
+
+/* Set baud rate and line options after all pending data was sent (timeout in ms, -1 = infinite) */
+extern int UART_reconfigure(uart_ctx_t *ctx, uart_t *uart, enum e_baud baud, const char *opt, int timeout);
+
+/* Apply a latency profile (returns UART_ENOTSUP if a setting isn't supported by the device) */
+extern int UART_set_latency(uart_ctx_t *ctx, uart_t *uart, const struct uart_latency *lat);
+
 /* Set baud rate from the UART interface */
 extern int UART_set_baud(uart_ctx_t *ctx, uart_t *uart, enum e_baud baud);
 
@@ -269,6 +567,12 @@ extern int UART_get_fd(uart_ctx_t *ctx, uart_t *uart, int *ret_fd);
 /* Get the device name from the UART interface */
 extern int UART_get_dev(uart_ctx_t *ctx, uart_t *uart, char **ret_dev);
 
+/* Get the device identity (driver, USB IDs, stable links) from the UART interface */
+extern int UART_get_dev_info(uart_ctx_t *ctx, uart_t *uart, struct uart_dev_info *ret_info);
+
+/* Get the PID of the process locking a device (0 if unknown or not locked) */
+extern int UART_get_dev_owner(uart_ctx_t *ctx, const char *devname, int *ret_pid);
+
 /**
  * libUART Miscellaneous Functions
  */
@@ -276,6 +580,15 @@ extern int UART_get_dev(uart_ctx_t *ctx, uart_t *uart, char **ret_dev);
 /* Get the available bytes in the receive channel from the UART interface */
 extern int UART_get_bytes_available(uart_ctx_t *ctx, uart_t *uart, int *ret_num);
 
+/* Get the number of bytes in the kernel input and output queue from the UART interface */
+extern int UART_get_queue_depth(uart_ctx_t *ctx, uart_t *uart, int *ret_in, int *ret_out);
+
+/* Get the line counters and the difference since the last call from the UART interface */
+extern int UART_get_counters(uart_ctx_t *ctx, uart_t *uart, struct uart_counters *ret_counters, struct uart_counters *ret_delta);
+
+/* Get the hardware flow control (CTS) statistics from the UART interface */
+extern int UART_get_flow_stats(uart_ctx_t *ctx, uart_t *uart, struct uart_flow_stats *ret_stats);
+
 /* Get last context error number */
 extern int UART_get_ctxerrro(uart_ctx_t *ctx);
 
@@ -302,15 +615,27 @@ extern char *UART_get_libversion(void);
 /* Create library context and initialize */
 extern LIBUART_API int UART_init(uart_ctx_t **ret_ctx);
 
+/* Create library context and initialize with flags (UART_INIT_*) */
+extern LIBUART_API int UART_init_ex(uart_ctx_t **ret_ctx, unsigned int flags);
+
 /* Free library context */
 extern LIBUART_API int UART_free(uart_ctx_t *ctx);
 
-/* Return a list from all current available UART devices on system */
+/* Return a list from all current available UART devices on system (valid until the next scan or open) */
 extern LIBUART_API ssize_t UART_get_device_list(uart_ctx_t *ctx, uart_t **ret_uarts);
 
-/* Opens an UART interface by device name */
+/* Rescan the UART devices and return the list and the changes since the last scan */
+extern LIBUART_API ssize_t UART_update_device_list(uart_ctx_t *ctx, uart_t **ret_uarts, struct uart_dev_changes *ret_changes);
+
+/* Opens an UART interface by device name (opt e.g. "8N1N", append X for exclusive access) */
 extern LIBUART_API uart_t *UART_dev_open_name(uart_ctx_t *ctx, const char *devname, enum e_baud baud, const char *opt);
 
+/* Opens multiple UART interfaces by device name concurrently (returns the number of opened interfaces) */
+extern LIBUART_API int UART_dev_open_many(uart_ctx_t *ctx, struct uart_open_req *reqs, int count);
+
+/* Find the first UART device matching the given identity (enumerates devices if not done yet) */
+extern LIBUART_API uart_t *UART_find_device(uart_ctx_t *ctx, const struct uart_dev_info *match);
+
 /* Opens an UART interface */
 extern LIBUART_API int UART_dev_open(uart_ctx_t *ctx, uart_t *uart, enum e_baud baud, const char *opt);
 
@@ -392,6 +717,9 @@ extern LIBUART_API int UART_get_handle(uart_ctx_t *ctx, uart_t *uart, HANDLE *re
 /* Get the device name from the UART interface */
 extern LIBUART_API int UART_get_dev(uart_ctx_t *ctx, uart_t *uart, char **ret_dev);
 
+/* Get the device identity (driver, USB IDs, stable links) from the UART interface */
+extern LIBUART_API int UART_get_dev_info(uart_ctx_t *ctx, uart_t *uart, struct uart_dev_info *ret_info);
+
 /**
  * libUART Miscellaneous Functions
  */
@@ -0,0 +1,65 @@
+/**
+ *
+ * libUART
+ *
+ * Easy to use library for accessing the UART
+ *
+ * Copyright (c) 2025 Johannes Krottmayer <krotti83@proton.me>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <stddef.h>
+#include <sys/ioctl.h>
+#include <asm/termbits.h>
+
+#include "_baud.h"
+
+int baud_set_custom(int fd,
+                    unsigned int iflag,
+                    unsigned int oflag,
+                    unsigned int cflag,
+                    unsigned int lflag,
+                    const unsigned char *cc,
+                    size_t ncc,
+                    int baud,
+                    int drain)
+{
+    int ret;
+    size_t i;
+    struct termios2 options;
+
+    ret = ioctl(fd, TCGETS2, &options);
+
+    if (ret == -1) {
+        return -1;
+    }
+
+    options.c_iflag = iflag;
+    options.c_oflag = oflag;
+    options.c_lflag = lflag;
+
+    /* the speed is taken from c_ispeed/c_ospeed with BOTHER */
+    options.c_cflag = cflag;
+    options.c_cflag &= ~(CBAUD | (CBAUD << IBSHIFT));
+    options.c_cflag |= (BOTHER | (BOTHER << IBSHIFT));
+    options.c_ispeed = (speed_t) baud;
+    options.c_ospeed = (speed_t) baud;
+
+    for (i = 0; (i < ncc) && (i < NCCS); i++) {
+        options.c_cc[i] = cc[i];
+    }
+
+    return ioctl(fd, (drain) ? TCSETSW2 : TCSETS2, &options);
+}
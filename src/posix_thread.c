@@ -20,12 +20,22 @@
  *
  */
 
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
 #include <pthread.h>
 #include <unistd.h>
+#include <signal.h>
+#include <time.h>
 #include <sys/ioctl.h>
 
+#ifdef __linux__
+#include <linux/serial.h>
+#endif
+
 #include "_uart.h"
 #include "_buffer.h"
+#include "_util.h"
 
 #include <UART.h>
 
@@ -36,10 +46,167 @@ struct _thread_args {
 
 #define THREAD_SLEEP_1MS        1000
 #define THREAD_BUFFER_SIZE      4096
+#define THREAD_OPEN_MAX         16
+#define THREAD_ECHO_MARGIN      100
+
+struct _open_args {
+    struct _uart_ctx *ctx;
+    struct _uart **uarts;
+    int *rets;
+    int count;
+    int next;
+    pthread_mutex_t lock;
+};
+
+#ifdef __linux__
+/* default signal that interrupts TIOCMIWAIT of the pin worker (EINTR) */
+#define THREAD_PIN_SIGNAL       SIGRTMIN
+
+/**
+ * TIOCMIWAIT can only be interrupted by a signal (it is no cancellation
+ * point and can't be polled), so the handler is installed while a pin
+ * worker runs and the previous disposition is restored afterwards.
+ */
+static pthread_mutex_t pin_signal_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t pin_signal_once = PTHREAD_ONCE_INIT;
+static pthread_key_t pin_signal_key;
+static struct sigaction pin_signal_old;
+static int pin_signal_num = 0;
+static int pin_signal_cur = 0;
+static int pin_signal_users = 0;
+
+static void pin_signal_key_init(void)
+{
+    pthread_key_create(&pin_signal_key, NULL);
+}
+
+/**
+ * Only the wakeups sent to a pin worker are ours, everything else is
+ * passed to the previous disposition
+ */
+static void pin_signal(int sig, siginfo_t *info, void *uctx)
+{
+    if ((info->si_code == SI_TKILL) && (info->si_pid == getpid()) &&
+        pthread_getspecific(pin_signal_key)) {
+        return;
+    }
+
+    if (pin_signal_old.sa_flags & SA_SIGINFO) {
+        pin_signal_old.sa_sigaction(sig, info, uctx);
+    } else if (pin_signal_old.sa_handler == SIG_DFL) {
+        /* the default action isn't ours to drop */
+        sigaction(sig, &pin_signal_old, NULL);
+        raise(sig);
+    } else if (pin_signal_old.sa_handler != SIG_IGN) {
+        pin_signal_old.sa_handler(sig);
+    }
+}
+
+/**
+ * Install the wakeup handler for the first pin worker, without
+ * SA_RESTART, otherwise the kernel restarts the ioctl instead of
+ * returning EINTR
+ */
+static int pin_signal_acquire(void)
+{
+    struct sigaction sa;
+    int ret = 0;
+
+    pthread_once(&pin_signal_once, pin_signal_key_init);
+    pthread_mutex_lock(&pin_signal_lock);
+
+    if (pin_signal_users == 0) {
+        pin_signal_cur = (pin_signal_num) ? pin_signal_num : THREAD_PIN_SIGNAL;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_sigaction = pin_signal;
+        sa.sa_flags = SA_SIGINFO;
+        sigemptyset(&sa.sa_mask);
+        ret = sigaction(pin_signal_cur, &sa, &pin_signal_old);
+    }
+
+    if (ret == 0) {
+        pin_signal_users++;
+    }
+
+    pthread_mutex_unlock(&pin_signal_lock);
+
+    return ret;
+}
+
+/**
+ * Restore the previous disposition after the last pin worker is gone
+ */
+static void pin_signal_release(void)
+{
+    pthread_mutex_lock(&pin_signal_lock);
+    pin_signal_users--;
+
+    if (pin_signal_users == 0) {
+        sigaction(pin_signal_cur, &pin_signal_old, NULL);
+    }
+
+    pthread_mutex_unlock(&pin_signal_lock);
+}
+
+/**
+ * Convert modem status bits (TIOCM_*) to a pin mask
+ */
+static int pin_state(int status)
+{
+    int state = 0;
+
+    if (status & TIOCM_CTS)
+        state |= UART_PIN_MASK(UART_PIN_CTS);
+
+    if (status & TIOCM_DSR)
+        state |= UART_PIN_MASK(UART_PIN_DSR);
+
+    if (status & TIOCM_CAR)
+        state |= UART_PIN_MASK(UART_PIN_DCD);
+
+    if (status & TIOCM_RNG)
+        state |= UART_PIN_MASK(UART_PIN_RI);
+
+    return state;
+}
+
+/**
+ * Pins with edges since the last call (counts short pulses as well,
+ * if the driver supports TIOCGICOUNT)
+ */
+static int pin_edges(int fd, struct serial_icounter_struct *last)
+{
+    int changed = 0;
+    struct serial_icounter_struct icount;
+
+    memset(&icount, 0, sizeof(icount));
+
+    if (ioctl(fd, TIOCGICOUNT, &icount) == -1) {
+        return 0;
+    }
+
+    if (icount.cts != last->cts)
+        changed |= UART_PIN_MASK(UART_PIN_CTS);
+
+    if (icount.dsr != last->dsr)
+        changed |= UART_PIN_MASK(UART_PIN_DSR);
+
+    if (icount.dcd != last->dcd)
+        changed |= UART_PIN_MASK(UART_PIN_DCD);
+
+    if (icount.rng != last->rng)
+        changed |= UART_PIN_MASK(UART_PIN_RI);
+
+    *(last) = icount;
+
+    return changed;
+}
+#endif
 
 int _uart_thread_init(struct _uart_ctx *ctx, struct _uart *uart)
 {
     int ret;
+    pthread_condattr_t attr;
 
     if (!ctx) {
         return UART_ECTX;
@@ -83,27 +250,345 @@ int _uart_thread_init(struct _uart_ctx *ctx, struct _uart *uart)
         return UART_ESYSAPI;
     }
 
+    /* the deadlines are taken from time_get_ms() (CLOCK_MONOTONIC) */
+    ret = pthread_condattr_init(&attr);
+
+    if (ret == 0) {
+        ret = pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+
+        if (ret == 0) {
+            ret = pthread_cond_init(&uart->tx_cond, &attr);
+        }
+
+        pthread_condattr_destroy(&attr);
+    }
+
+    if (ret != 0) {
+        _uart_error(ctx, uart, UART_ESYSAPI, "pthread_cond_init", NULL);
+
+        return UART_ESYSAPI;
+    }
+
+    ret = pthread_mutex_init(&uart->echo_lock, NULL);
+
+    if (ret != 0) {
+        _uart_error(ctx, uart, UART_ESYSAPI, "pthread_mutex_init", NULL);
+
+        return UART_ESYSAPI;
+    }
+
+    ret = pthread_mutex_init(&uart->link_lock, NULL);
+
+    if (ret != 0) {
+        _uart_error(ctx, uart, UART_ESYSAPI, "pthread_mutex_init", NULL);
+
+        return UART_ESYSAPI;
+    }
+
+    ret = pthread_mutex_init(&uart->pin_mutex, NULL);
+
+    if (ret != 0) {
+        _uart_error(ctx, uart, UART_ESYSAPI, "pthread_mutex_init", NULL);
+
+        return UART_ESYSAPI;
+    }
+
+    uart->echo_buffer = NULL;
+    uart->echo_rec_head = 0;
+    uart->echo_rec_num = 0;
+    uart->echo = 0;
+    uart->collisions = 0;
+    memset(&uart->reconnect, 0, sizeof(uart->reconnect));
+    uart->link_gen = 0;
+    uart->link_state = UART_LINK_UP;
+    uart->reconnects = 0;
+    uart->thread_args = NULL;
+    uart->pin_thread_started = 0;
+    uart->pin_thread_run = 0;
+    uart->pin_thread_stop = 0;
+    uart->pin_event = 0;
+    uart->pin_mask = 0;
+    uart->pin_cb = NULL;
+    uart->pin_arg = NULL;
+
     return UART_ESUCCESS;
 }
 
+/**
+ * Remove bytes from the start of the echo stream (echo_lock held)
+ */
+static void echo_drop(struct _uart *uart, ssize_t len)
+{
+    struct _uart_echo *rec;
+
+    buffer_skip(uart->echo_buffer, len);
+
+    while ((len > 0) && (uart->echo_rec_num > 0)) {
+        rec = &uart->echo_rec[uart->echo_rec_head];
+
+        if (rec->len > len) {
+            rec->len -= len;
+
+            break;
+        }
+
+        len -= rec->len;
+        uart->echo_rec_head = (uart->echo_rec_head + 1) % UART_ECHORECMAX;
+        uart->echo_rec_num--;
+    }
+}
+
+/**
+ * Append transmitted data to the echo stream (echo_lock held), the
+ * data is on the line after the previously written data
+ */
+static void echo_add(struct _uart *uart, unsigned char *data, ssize_t len)
+{
+    struct _uart_echo *last = NULL;
+    ssize_t num;
+    long long end;
+
+    num = buffer_get_free(uart->echo_buffer);
+
+    if (num < len) {
+        echo_drop(uart, len - num);
+    }
+
+    end = time_get_ms();
+
+    if (uart->echo_rec_num > 0) {
+        last = &uart->echo_rec[(uart->echo_rec_head + uart->echo_rec_num - 1) % UART_ECHORECMAX];
+
+        if (last->end > end) {
+            end = last->end;
+        }
+    }
+
+    /* 10 bits per character (start, 8 data, stop) */
+    if ((int) uart->baud > 0) {
+        end += ((long long) len * 10 * 1000) / (int) uart->baud + 1;
+    }
+
+    buffer_wr(uart->echo_buffer, data, len);
+
+    /* a full record list merges into the last record */
+    if (uart->echo_rec_num == UART_ECHORECMAX) {
+        last->len += len;
+        last->end = end;
+    } else {
+        last = &uart->echo_rec[(uart->echo_rec_head + uart->echo_rec_num) % UART_ECHORECMAX];
+        last->len = len;
+        last->end = end;
+        uart->echo_rec_num++;
+    }
+}
+
+/**
+ * Forget transmitted data whose echo didn't arrive in time (no loopback
+ * or the driver disabled the receiver while sending)
+ */
+static void echo_expire(struct _uart *uart)
+{
+    struct _uart_echo *rec;
+    long long now;
+
+    now = time_get_ms();
+
+    while (uart->echo_rec_num > 0) {
+        rec = &uart->echo_rec[uart->echo_rec_head];
+
+        if (rec->end + THREAD_ECHO_MARGIN > now) {
+            break;
+        }
+
+        echo_drop(uart, rec->len);
+    }
+}
+
+/**
+ * Compare received data with the transmitted data (echo suppression),
+ * returns the number of echoed bytes at the start of the received data
+ */
+static ssize_t echo_filter(struct _uart *uart, unsigned char *data, ssize_t len)
+{
+    unsigned char echo[THREAD_BUFFER_SIZE];
+    ssize_t num;
+    ssize_t i;
+
+    pthread_mutex_lock(&uart->echo_lock);
+
+    if (!uart->echo) {
+        pthread_mutex_unlock(&uart->echo_lock);
+
+        return 0;
+    }
+
+    echo_expire(uart);
+    num = buffer_get_num(uart->echo_buffer);
+
+    if (num > len) {
+        num = len;
+    }
+
+    if (num > 0) {
+        buffer_peek(uart->echo_buffer, echo, num);
+
+        /* the position is only needed on a collision */
+        if (memcmp(data, echo, (size_t) num) == 0) {
+            echo_drop(uart, num);
+        } else {
+            for (i = 0; data[i] == echo[i]; i++)
+                ;
+
+            /* the rest of the transmitted data was corrupted on the bus */
+            echo_drop(uart, buffer_get_num(uart->echo_buffer));
+            uart->collisions++;
+            num = i;
+        }
+    }
+
+    pthread_mutex_unlock(&uart->echo_lock);
+
+    return num;
+}
+
+static int worker_running(struct _uart *uart, int rx)
+{
+    int run;
+
+    pthread_mutex_lock((rx) ? &uart->rx_mutex : &uart->tx_mutex);
+    run = (rx) ? uart->rx_thread_run : uart->tx_thread_run;
+    pthread_mutex_unlock((rx) ? &uart->rx_mutex : &uart->tx_mutex);
+
+    return run;
+}
+
+/**
+ * Tell the pin worker that the device was reopened (1) or is lost (-1),
+ * the signal ends a wait on the old device
+ */
+static void pin_notify(struct _uart *uart, int event)
+{
+#ifdef __linux__
+    pthread_mutex_lock(&uart->pin_mutex);
+
+    if (uart->pin_thread_run) {
+        uart->pin_event = event;
+        pthread_kill(uart->pin_thread, pin_signal_cur);
+    }
+
+    pthread_mutex_unlock(&uart->pin_mutex);
+#else
+    (void) uart;
+    (void) event;
+#endif
+}
+
+/**
+ * Handle a failed device access of a worker (called without rx_lock or
+ * tx_lock held, so the application can still use the buffers)
+ *
+ * The first worker reopens the device with backoff, the other one
+ * waits on link_lock and continues with the reopened device (same
+ * descriptor number). Returns 1 if the worker can continue.
+ */
+static int link_lost(struct _thread_args *args, unsigned long gen, int rx)
+{
+    struct _uart *uart = args->uart;
+    int delay;
+    int tries = 0;
+    int waited;
+    int ret = 0;
+
+    pthread_mutex_lock(&uart->link_lock);
+
+    if (uart->link_gen != gen) {
+        pthread_mutex_unlock(&uart->link_lock);
+
+        return 1;
+    }
+
+    /* also after giving up, the other worker must not start over */
+    if (!uart->reconnect.enable || (uart->link_state == UART_LINK_FAILED)) {
+        uart->link_state = UART_LINK_FAILED;
+        pthread_mutex_unlock(&uart->link_lock);
+        pin_notify(uart, -1);
+
+        return 0;
+    }
+
+    uart->link_state = UART_LINK_DOWN;
+    delay = (uart->reconnect.delay_min > 0) ? uart->reconnect.delay_min : 1;
+
+    while (worker_running(uart, rx)) {
+        if (_uart_reopen(args->ctx, uart) == UART_ESUCCESS) {
+            uart->link_gen++;
+            uart->link_state = UART_LINK_UP;
+            uart->reconnects++;
+            ret = 1;
+
+            break;
+        }
+
+        tries++;
+
+        /* the policy stays as set by the application */
+        if ((uart->reconnect.max_tries > 0) && (tries >= uart->reconnect.max_tries)) {
+            uart->link_state = UART_LINK_FAILED;
+
+            break;
+        }
+
+        /* sleep in short steps, closing the device stops the worker */
+        for (waited = 0; (waited < delay) && worker_running(uart, rx); waited += 10) {
+            usleep(10 * THREAD_SLEEP_1MS);
+        }
+
+        delay *= 2;
+
+        if ((uart->reconnect.delay_max > 0) && (delay > uart->reconnect.delay_max)) {
+            delay = uart->reconnect.delay_max;
+        }
+    }
+
+    pthread_mutex_unlock(&uart->link_lock);
+
+    /* the pin worker waits on the old device or for the reconnect */
+    if (ret) {
+        pin_notify(uart, 1);
+    } else if (uart->link_state == UART_LINK_FAILED) {
+        pin_notify(uart, -1);
+    }
+
+    return ret;
+}
+
 void *worker_thread_rx(void *p)
 {
     int run = 1;
     struct _thread_args *args = (struct _thread_args *) p;
     ssize_t len;
     ssize_t ret;
+    ssize_t skip;
     unsigned char buf[THREAD_BUFFER_SIZE];
     int bytes;
     int ret_ioctl;
+    unsigned long gen;
 
     while (run) {
         pthread_mutex_lock(&args->uart->rx_lock);
 
+        gen = args->uart->link_gen;
         ret_ioctl = ioctl(args->uart->fd, FIONREAD, &bytes);
 
         if (ret_ioctl == -1) {
             _uart_error(args->ctx, args->uart, UART_ESYSAPI, "ioctl", NULL);
             pthread_mutex_unlock(&args->uart->rx_lock);
+
+            if (link_lost(args, gen, 1)) {
+                continue;
+            }
+
             pthread_mutex_lock(&args->uart->rx_mutex);
             args->uart->rx_thread_run = 0;
             pthread_mutex_unlock(&args->uart->rx_mutex);
@@ -113,20 +598,47 @@ void *worker_thread_rx(void *p)
 
         len = buffer_get_free(args->uart->rx_buffer);
 
-        if (len >= bytes) {
+        if (bytes > THREAD_BUFFER_SIZE) {
+            bytes = THREAD_BUFFER_SIZE;
+        }
+
+        if ((bytes > 0) && (len >= bytes)) {
             ret = read(args->uart->fd, buf, bytes);
 
             if (ret == -1) {
-                _uart_error(args->ctx, args->uart, UART_ESYSAPI, "read", NULL);
-                pthread_mutex_unlock(&args->uart->rx_lock);
-                pthread_mutex_lock(&args->uart->rx_mutex);
-                args->uart->rx_thread_run = 0;
-                pthread_mutex_unlock(&args->uart->rx_mutex);
+                if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR)) {
+                    _uart_error(args->ctx, args->uart, UART_ESYSAPI, "read", NULL);
+                    pthread_mutex_unlock(&args->uart->rx_lock);
+
+                    if (link_lost(args, gen, 1)) {
+                        continue;
+                    }
+
+                    pthread_mutex_lock(&args->uart->rx_mutex);
+                    args->uart->rx_thread_run = 0;
+                    pthread_mutex_unlock(&args->uart->rx_mutex);
+
+                    return NULL;
+                }
+
+                ret = 0;
+            }
+
+            /* decoded first, a sent 0xFF is received as 0xFF 0xFF */
+            if (((args->uart->md_addr >= 0) || args->uart->rx_errors) && (ret > 0)) {
+                ret = _uart_parmrk_filter(args->uart, buf, ret);
+            }
+
+            skip = echo_filter(args->uart, buf, ret);
 
-                return NULL;
+            if (skip > 0) {
+                _uart_rx_error_skip(args->uart, skip);
             }
 
-            buffer_wr(args->uart->rx_buffer, buf, bytes);
+            if (ret > skip) {
+                buffer_wr(args->uart->rx_buffer, buf + skip, ret - skip);
+                args->uart->rx_offset += (unsigned long long) (ret - skip);
+            }
         }
 
         pthread_mutex_unlock(&args->uart->rx_lock);
@@ -150,61 +662,100 @@ void *worker_thread_tx(void *p)
     ssize_t ret;
     unsigned char buf[THREAD_BUFFER_SIZE];
     ssize_t len;
-
+    int rs485_active = 0;
+    int echo;
+    unsigned long gen;
 
     while (run) {
         pthread_mutex_lock(&args->uart->tx_lock);
+        gen = args->uart->link_gen;
         len = buffer_get_num(args->uart->tx_buffer);
 
-        if (len >= THREAD_BUFFER_SIZE) {
-            buffer_rd(args->uart->tx_buffer, buf, THREAD_BUFFER_SIZE);
-            ret = write(args->uart->fd, buf, THREAD_BUFFER_SIZE);
+        if (len > THREAD_BUFFER_SIZE) {
+            len = THREAD_BUFFER_SIZE;
+        }
 
-            if (ret == -1) {
-                _uart_error(args->ctx, args->uart, UART_ESYSAPI, "write", NULL);
-                pthread_mutex_unlock(&args->uart->tx_lock);
-                pthread_mutex_lock(&args->uart->tx_mutex);
-                args->uart->tx_thread_run = 0;
-                pthread_mutex_unlock(&args->uart->tx_mutex);
+        if ((len > 0) && !rs485_active) {
+            _uart_rs485_begin(args->ctx, args->uart);
+            rs485_active = 1;
+        }
 
-                return NULL;
+        if (len > 0) {
+            /**
+             * Data stays in the buffer until the kernel accepted it,
+             * a partial write only removes the sent bytes.
+             */
+            buffer_peek(args->uart->tx_buffer, buf, len);
+
+            /**
+             * The sent data is stored for echo suppression before the RX
+             * worker may compare against it (echo_lock held over write).
+             */
+            pthread_mutex_lock(&args->uart->echo_lock);
+            echo = args->uart->echo;
+
+            if (!echo) {
+                pthread_mutex_unlock(&args->uart->echo_lock);
             }
 
-            if (ret != (ssize_t) len) {
-                _uart_error(args->ctx, args->uart, UART_ESYSAPI, "write", "could not send all data");
-                pthread_mutex_unlock(&args->uart->tx_lock);
-                pthread_mutex_lock(&args->uart->tx_mutex);
-                args->uart->tx_thread_run = 0;
-                pthread_mutex_unlock(&args->uart->tx_mutex);
+            ret = write(args->uart->fd, buf, len);
+
+            if (echo) {
+                if (ret > 0) {
+                    echo_add(args->uart, buf, ret);
+                }
 
-                return NULL;
+                pthread_mutex_unlock(&args->uart->echo_lock);
             }
-        } else if (len > 1) {
-            buffer_rd(args->uart->tx_buffer, buf, len);
-            ret = write(args->uart->fd, buf, len);
 
             if (ret == -1) {
-                _uart_error(args->ctx, args->uart, UART_ESYSAPI, "write", NULL);
-                pthread_mutex_unlock(&args->uart->tx_lock);
-                pthread_mutex_lock(&args->uart->tx_mutex);
-                args->uart->tx_thread_run = 0;
-                pthread_mutex_unlock(&args->uart->tx_mutex);
+                if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR)) {
+                    _uart_error(args->ctx, args->uart, UART_ESYSAPI, "write", NULL);
+                    pthread_mutex_unlock(&args->uart->tx_lock);
+
+                    /* unsent data stays in tx_buffer for the reopened device */
+                    if (link_lost(args, gen, 0)) {
+                        rs485_active = 0;
+
+                        continue;
+                    }
 
-                return NULL;
+                    pthread_mutex_lock(&args->uart->tx_mutex);
+                    args->uart->tx_thread_run = 0;
+                    pthread_mutex_unlock(&args->uart->tx_mutex);
+
+                    return NULL;
+                }
+
+                ret = 0;
             }
 
-            if (ret != (ssize_t) len) {
-                _uart_error(args->ctx, args->uart, UART_ESYSAPI, "write", "could not send all data");
-                pthread_mutex_unlock(&args->uart->tx_lock);
-                pthread_mutex_lock(&args->uart->tx_mutex);
-                args->uart->tx_thread_run = 0;
-                pthread_mutex_unlock(&args->uart->tx_mutex);
+            buffer_skip(args->uart->tx_buffer, ret);
 
-                return NULL;
+            /* wake up senders waiting for free space or an empty buffer */
+            if (ret > 0) {
+                pthread_cond_broadcast(&args->uart->tx_cond);
             }
         }
 
+        len = buffer_get_num(args->uart->tx_buffer);
+
+        /* an idle worker doesn't poll the modem lines */
+        if ((len > 0) || args->uart->flow_pending) {
+            _uart_flow_update(args->ctx, args->uart, len > 0);
+        }
+
+        /**
+         * Switch the bus direction back after the buffer ran empty, with
+         * tx_lock held, so UART_send_address() can't overlap with it.
+         */
+        if ((len == 0) && rs485_active) {
+            _uart_rs485_end(args->ctx, args->uart);
+            rs485_active = 0;
+        }
+
         pthread_mutex_unlock(&args->uart->tx_lock);
+
         pthread_mutex_lock(&args->uart->tx_mutex);
 
         if (!args->uart->tx_thread_run) {
@@ -218,10 +769,147 @@ void *worker_thread_tx(void *p)
     return NULL;
 }
 
-int _uart_thread_start(struct _uart_ctx *ctx, struct _uart *uart)
+#ifdef __linux__
+static int pin_stopping(struct _uart *uart)
+{
+    int stop;
+
+    pthread_mutex_lock(&uart->pin_mutex);
+    stop = uart->pin_thread_stop;
+    pthread_mutex_unlock(&uart->pin_mutex);
+
+    return stop;
+}
+
+/**
+ * Take the link event for the pin worker (1 reopened, -1 lost), with
+ * wait set until there is one (-1 on stop as well)
+ */
+static int pin_link_event(struct _uart *uart, int wait)
+{
+    int event;
+    int stop;
+
+    while (1) {
+        pthread_mutex_lock(&uart->pin_mutex);
+        event = uart->pin_event;
+        uart->pin_event = 0;
+        stop = uart->pin_thread_stop;
+        pthread_mutex_unlock(&uart->pin_mutex);
+
+        if (stop) {
+            return -1;
+        }
+
+        if (event || !wait) {
+            return event;
+        }
+
+        usleep(10 * THREAD_SLEEP_1MS);
+    }
+}
+
+void *worker_thread_pin(void *p)
+{
+    struct _thread_args *args = (struct _thread_args *) p;
+    struct serial_icounter_struct icount;
+    sigset_t set;
+    int ret;
+    int status;
+    int state;
+    int state_old;
+    int changed;
+    int wait_mask = 0;
+    int event;
+    long long timestamp;
+
+    /* the wakeup signal may be blocked in the thread that started us */
+    pthread_setspecific(pin_signal_key, args->uart);
+    sigemptyset(&set);
+    sigaddset(&set, pin_signal_cur);
+    pthread_sigmask(SIG_UNBLOCK, &set, NULL);
+
+    if (args->uart->pin_mask & UART_PIN_MASK(UART_PIN_CTS))
+        wait_mask |= TIOCM_CTS;
+
+    if (args->uart->pin_mask & UART_PIN_MASK(UART_PIN_DSR))
+        wait_mask |= TIOCM_DSR;
+
+    if (args->uart->pin_mask & UART_PIN_MASK(UART_PIN_DCD))
+        wait_mask |= TIOCM_CAR;
+
+    if (args->uart->pin_mask & UART_PIN_MASK(UART_PIN_RI))
+        wait_mask |= TIOCM_RNG;
+
+    status = 0;
+    ioctl(args->uart->fd, TIOCMGET, &status);
+    state_old = pin_state(status);
+    memset(&icount, 0, sizeof(icount));
+    pin_edges(args->uart->fd, &icount);
+
+    while (!pin_stopping(args->uart)) {
+        /* TIOCMIWAIT blocks until one of the lines changes or a signal */
+        ret = ioctl(args->uart->fd, TIOCMIWAIT, wait_mask);
+        timestamp = time_get_ms();
+
+        if (ret == -1) {
+            /* a lost device is reopened by the RX and TX workers */
+            if (errno == EINTR) {
+                event = pin_link_event(args->uart, 0);
+            } else if ((errno == EIO) || (errno == ENODEV) || (errno == ENXIO)) {
+                _uart_error(args->ctx, args->uart, UART_ESYSAPI, "ioctl", "TIOCMIWAIT");
+                event = pin_link_event(args->uart, 1);
+            } else {
+                _uart_error(args->ctx, args->uart, UART_ESYSAPI, "ioctl", "TIOCMIWAIT");
+
+                break;
+            }
+
+            if (event == -1) {
+                break;
+            }
+
+            if (event == 0) {
+                continue;
+            }
+
+            /* the reopened device has its own counters */
+            memset(&icount, 0, sizeof(icount));
+            pin_edges(args->uart->fd, &icount);
+        }
+
+        ret = ioctl(args->uart->fd, TIOCMGET, &status);
+
+        if (ret == -1) {
+            _uart_error(args->ctx, args->uart, UART_ESYSAPI, "ioctl", "TIOCMGET");
+
+            break;
+        }
+
+        state = pin_state(status);
+        changed = (state ^ state_old) | pin_edges(args->uart->fd, &icount);
+        changed &= args->uart->pin_mask;
+        state_old = state;
+
+        if (changed) {
+            args->uart->pin_cb(args->uart, state, changed, timestamp, args->uart->pin_arg);
+        }
+    }
+
+    /* also after an error, the callback isn't called anymore */
+    pthread_mutex_lock(&args->uart->pin_mutex);
+    args->uart->pin_thread_run = 0;
+    pthread_mutex_unlock(&args->uart->pin_mutex);
+
+    return NULL;
+}
+#endif
+
+int _uart_thread_pin_start(struct _uart_ctx *ctx, struct _uart *uart)
 {
+#ifdef __linux__
     int ret;
-    struct _thread_args args;
+#endif
 
     if (!ctx) {
         return UART_ECTX;
@@ -233,11 +921,211 @@ int _uart_thread_start(struct _uart_ctx *ctx, struct _uart *uart)
         return UART_EHANDLE;
     }
 
+#ifdef __linux__
+    if (!uart->thread_args) {
+        _uart_error(ctx, uart, UART_EDEV, NULL, "not opened");
+
+        return UART_EDEV;
+    }
+
+    if (pin_signal_acquire() == -1) {
+        _uart_error(ctx, uart, UART_ESYSAPI, "sigaction", NULL);
+
+        return UART_ESYSAPI;
+    }
+
+    uart->pin_thread_run = 1;
+    uart->pin_thread_stop = 0;
+    uart->pin_event = 0;
+    ret = pthread_create(&uart->pin_thread, NULL, worker_thread_pin, uart->thread_args);
+
+    if (ret != 0) {
+        uart->pin_thread_run = 0;
+        pin_signal_release();
+        _uart_error(ctx, uart, UART_ESYSAPI, "pthread_create", NULL);
+
+        return UART_ESYSAPI;
+    }
+
+    uart->pin_thread_started = 1;
+
+    return UART_ESUCCESS;
+#else
+    _uart_error(ctx, uart, UART_ENOTSUP, NULL, "TIOCMIWAIT");
+
+    return UART_ENOTSUP;
+#endif
+}
+
+int _uart_thread_pin_stop(struct _uart_ctx *ctx, struct _uart *uart)
+{
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+#ifdef __linux__
+    if (uart->pin_thread_started) {
+        pthread_mutex_lock(&uart->pin_mutex);
+        uart->pin_thread_stop = 1;
+        pthread_mutex_unlock(&uart->pin_mutex);
+
+        /**
+         * A signal sent right before the worker enters the ioctl is lost,
+         * so repeat it until the worker is gone.
+         */
+        while (1) {
+            pthread_mutex_lock(&uart->pin_mutex);
+
+            if (!uart->pin_thread_run) {
+                pthread_mutex_unlock(&uart->pin_mutex);
+
+                break;
+            }
+
+            pthread_kill(uart->pin_thread, pin_signal_cur);
+            pthread_mutex_unlock(&uart->pin_mutex);
+            usleep(THREAD_SLEEP_1MS);
+        }
+
+        pthread_join(uart->pin_thread, NULL);
+        uart->pin_thread_started = 0;
+        pin_signal_release();
+    }
+#endif
+
+    return UART_ESUCCESS;
+}
+
+int _uart_thread_pin_signal(struct _uart_ctx *ctx, int signum)
+{
+#ifdef __linux__
+    int ret = UART_ESUCCESS;
+#endif
+
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+#ifdef __linux__
+    /* 0 selects the default, the application keeps the other signals */
+    if ((signum != 0) && (signum != SIGUSR1) && (signum != SIGUSR2) &&
+        ((signum < SIGRTMIN) || (signum > SIGRTMAX))) {
+        _uart_error(ctx, NULL, UART_EINVAL, NULL, "signal");
+
+        return UART_EINVAL;
+    }
+
+    pthread_mutex_lock(&pin_signal_lock);
+
+    if (pin_signal_users > 0) {
+        ret = UART_EBUSY;
+    } else {
+        pin_signal_num = signum;
+    }
+
+    pthread_mutex_unlock(&pin_signal_lock);
+
+    if (ret != UART_ESUCCESS) {
+        _uart_error(ctx, NULL, ret, NULL, "pin callback active");
+    }
+
+    return ret;
+#else
+    (void) signum;
+    _uart_error(ctx, NULL, UART_ENOTSUP, NULL, "TIOCMIWAIT");
+
+    return UART_ENOTSUP;
+#endif
+}
+
+static void *worker_thread_open(void *p)
+{
+    struct _open_args *args = (struct _open_args *) p;
+    int i;
+
+    for (;;) {
+        pthread_mutex_lock(&args->lock);
+        i = args->next++;
+        pthread_mutex_unlock(&args->lock);
+
+        if (i >= args->count) {
+            break;
+        }
+
+        /* errors are stored in the device, so the opens are independent */
+        args->rets[i] = _uart_open(args->ctx, args->uarts[i]);
+    }
+
+    return NULL;
+}
+
+void _uart_thread_open_many(struct _uart_ctx *ctx, struct _uart **uarts, int *rets, int count)
+{
+    struct _open_args args;
+    pthread_t threads[THREAD_OPEN_MAX];
+    int num = 0;
+
     args.ctx = ctx;
-    args.uart = uart;
+    args.uarts = uarts;
+    args.rets = rets;
+    args.count = count;
+    args.next = 0;
+    pthread_mutex_init(&args.lock, NULL);
+
+    /* the calling thread works too, so a failed pthread_create is harmless */
+    while ((num < THREAD_OPEN_MAX) && (num < count - 1)) {
+        if (pthread_create(&threads[num], NULL, worker_thread_open, &args) != 0) {
+            break;
+        }
+
+        num++;
+    }
+
+    worker_thread_open(&args);
+
+    while (num > 0) {
+        pthread_join(threads[--num], NULL);
+    }
+
+    pthread_mutex_destroy(&args.lock);
+}
+
+int _uart_thread_start(struct _uart_ctx *ctx, struct _uart *uart)
+{
+    int ret;
+    struct _thread_args *args;
+
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+    /* arguments must stay valid as long as the workers are running */
+    args = (struct _thread_args *) malloc(sizeof(struct _thread_args));
+
+    if (!args) {
+        _uart_error(ctx, uart, UART_ENOMEM, NULL, NULL);
+
+        return UART_ENOMEM;
+    }
+
+    args->ctx = ctx;
+    args->uart = uart;
+    uart->thread_args = args;
     uart->rx_thread_run = 1;
     uart->tx_thread_run = 1;
-    ret = pthread_create(&uart->rx_thread, NULL, worker_thread_rx, (void *) &args);
+    ret = pthread_create(&uart->rx_thread, NULL, worker_thread_rx, (void *) args);
 
     if (ret != 0) {
         _uart_error(ctx, uart, UART_ESYSAPI, "pthread_create", NULL);
@@ -245,7 +1133,7 @@ int _uart_thread_start(struct _uart_ctx *ctx, struct _uart *uart)
         return UART_ESYSAPI;
     }
 
-    ret = pthread_create(&uart->tx_thread, NULL, worker_thread_tx, (void *) &args);
+    ret = pthread_create(&uart->tx_thread, NULL, worker_thread_tx, (void *) args);
 
     if (ret != 0) {
         _uart_error(ctx, uart, UART_ESYSAPI, "pthread_create", NULL);
@@ -270,6 +1158,8 @@ int _uart_thread_stop(struct _uart_ctx *ctx, struct _uart *uart)
         return UART_EHANDLE;
     }
 
+    _uart_thread_pin_stop(ctx, uart);
+
     pthread_mutex_lock(&uart->rx_mutex);
     uart->rx_thread_run = 0;
     pthread_mutex_unlock(&uart->rx_mutex);
@@ -280,6 +1170,47 @@ int _uart_thread_stop(struct _uart_ctx *ctx, struct _uart *uart)
 
     pthread_join(uart->rx_thread, NULL);
     pthread_join(uart->tx_thread, NULL);
+    free(uart->thread_args);
+    uart->thread_args = NULL;
+
+    if (uart->echo_buffer) {
+        buffer_free(uart->echo_buffer);
+        uart->echo_buffer = NULL;
+    }
+
+    uart->echo = 0;
+
+    ret = pthread_mutex_destroy(&uart->pin_mutex);
+
+    if (ret != 0) {
+        _uart_error(ctx, uart, UART_ESYSAPI, "pthread_mutex_destroy", NULL);
+
+        return UART_ESYSAPI;
+    }
+
+    ret = pthread_mutex_destroy(&uart->link_lock);
+
+    if (ret != 0) {
+        _uart_error(ctx, uart, UART_ESYSAPI, "pthread_mutex_destroy", NULL);
+
+        return UART_ESYSAPI;
+    }
+
+    ret = pthread_cond_destroy(&uart->tx_cond);
+
+    if (ret != 0) {
+        _uart_error(ctx, uart, UART_ESYSAPI, "pthread_cond_destroy", NULL);
+
+        return UART_ESYSAPI;
+    }
+
+    ret = pthread_mutex_destroy(&uart->echo_lock);
+
+    if (ret != 0) {
+        _uart_error(ctx, uart, UART_ESYSAPI, "pthread_mutex_destroy", NULL);
+
+        return UART_ESYSAPI;
+    }
 
     ret = pthread_mutex_destroy(&uart->rx_mutex);
 
@@ -350,6 +1281,81 @@ int _uart_thread_lock_tx(struct _uart_ctx *ctx, struct _uart *uart)
     return UART_ESUCCESS;
 }
 
+int _uart_thread_wait_tx(struct _uart_ctx *ctx, struct _uart *uart, long long deadline)
+{
+    struct timespec ts;
+    int ret;
+
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+    /**
+     * Called with the TX lock held, returns after the TX worker wrote
+     * data from the buffer or the deadline (time_get_ms(), -1 = none)
+     * passed. Spurious wake ups are left to the caller's loop.
+     */
+    if (deadline < 0) {
+        pthread_cond_wait(&uart->tx_cond, &uart->tx_lock);
+
+        return UART_ESUCCESS;
+    }
+
+    ts.tv_sec = (time_t) (deadline / 1000);
+    ts.tv_nsec = (long) ((deadline % 1000) * 1000000);
+
+    ret = pthread_cond_timedwait(&uart->tx_cond, &uart->tx_lock, &ts);
+
+    if (ret == ETIMEDOUT) {
+        return UART_ETIMEOUT;
+    }
+
+    return UART_ESUCCESS;
+}
+
+int _uart_thread_pause_tx(struct _uart_ctx *ctx, struct _uart *uart, int timeout)
+{
+    long long deadline = 0;
+
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+    if (timeout >= 0) {
+        deadline = time_get_ms() + timeout;
+    }
+
+    /**
+     * Wait until the TX worker handed all queued data to the kernel and
+     * keep the TX lock, so neither the worker nor UART_send() can queue
+     * or write more data until _uart_thread_unlock_tx() is called.
+     */
+    pthread_mutex_lock(&uart->tx_lock);
+
+    while (buffer_get_num(uart->tx_buffer) != 0) {
+        if (_uart_thread_wait_tx(ctx, uart, (timeout >= 0) ? deadline : -1) == UART_ETIMEOUT) {
+            pthread_mutex_unlock(&uart->tx_lock);
+            _uart_error(ctx, uart, UART_ETIMEOUT, NULL, "transmit buffer not empty");
+
+            return UART_ETIMEOUT;
+        }
+    }
+
+    return UART_ESUCCESS;
+}
+
 int _uart_thread_unlock_rx(struct _uart_ctx *ctx, struct _uart *uart)
 {
     if (!ctx) {
@@ -23,672 +23,2394 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
+#include <limits.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <grp.h>
+#include <poll.h>
 #include <termios.h>
+#include <signal.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
+#include <sys/file.h>
+#include <sys/stat.h>
 #include <dirent.h>
 
+#ifdef __linux__
+#include <sys/sysmacros.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/serial.h>
+#endif
+
 #include "_uart.h"
 #include "_util.h"
 
+#ifdef __linux__
+#include "_baud.h"
+#endif
+
 #include <UART.h>
 
-int _uart_baud_valid(int value)
-{
-    int E[] = {
-        UART_BAUD_0,
-        UART_BAUD_50,
-        UART_BAUD_75,
-        UART_BAUD_110,
-        UART_BAUD_134,
-        UART_BAUD_150,
-        UART_BAUD_200,
-        UART_BAUD_300,
-        UART_BAUD_600,
-        UART_BAUD_1200,
-        UART_BAUD_1800,
-        UART_BAUD_2400,
-        UART_BAUD_4800,
-        UART_BAUD_9600,
-        UART_BAUD_19200,
-        UART_BAUD_38400,
-        UART_BAUD_57600,
-        UART_BAUD_115200,
-        UART_BAUD_230400,
-        UART_BAUD_460800,
-        UART_BAUD_500000,
+/**
+ * Mapping from the supported baud rates to the termios speed values,
+ * sorted ascending by baud rate
+ */
+static const struct {
+    int baud;
+    speed_t speed;
+} baud_table[] = {
+    { UART_BAUD_0, B0 },
+    { UART_BAUD_50, B50 },
+    { UART_BAUD_75, B75 },
+    { UART_BAUD_110, B110 },
+    { UART_BAUD_134, B134 },
+    { UART_BAUD_150, B150 },
+    { UART_BAUD_200, B200 },
+    { UART_BAUD_300, B300 },
+    { UART_BAUD_600, B600 },
+    { UART_BAUD_1200, B1200 },
+    { UART_BAUD_1800, B1800 },
+    { UART_BAUD_2400, B2400 },
+    { UART_BAUD_4800, B4800 },
+    { UART_BAUD_9600, B9600 },
+    { UART_BAUD_19200, B19200 },
+    { UART_BAUD_38400, B38400 },
+    { UART_BAUD_57600, B57600 },
+    { UART_BAUD_115200, B115200 },
+    { UART_BAUD_230400, B230400 },
+    { UART_BAUD_460800, B460800 },
+    { UART_BAUD_500000, B500000 },
 #ifdef __linux__
-        UART_BAUD_576000,
+    { UART_BAUD_576000, B576000 },
 #endif
-        UART_BAUD_921600,
-        UART_BAUD_1000000,
+    { UART_BAUD_921600, B921600 },
+    { UART_BAUD_1000000, B1000000 },
 #ifdef __linux__
-        UART_BAUD_1152000,
+    { UART_BAUD_1152000, B1152000 },
 #endif
-        UART_BAUD_1500000,
-        UART_BAUD_2000000,
-        UART_BAUD_2500000,
-        UART_BAUD_3000000,
-        UART_BAUD_3500000,
-        UART_BAUD_4000000
-    };
-    
-    if (enum_contains(E, sizeof(E)/sizeof(E[0]), value))
+    { UART_BAUD_1500000, B1500000 },
+    { UART_BAUD_2000000, B2000000 },
+    { UART_BAUD_2500000, B2500000 },
+    { UART_BAUD_3000000, B3000000 },
+    { UART_BAUD_3500000, B3500000 },
+    { UART_BAUD_4000000, B4000000 },
+};
+
+static int baud_lookup(int value)
+{
+    int lo = 0;
+    int hi = (int) (sizeof(baud_table) / sizeof(baud_table[0])) - 1;
+    int mid;
+
+    while (lo <= hi) {
+        mid = (lo + hi) / 2;
+
+        if (baud_table[mid].baud == value) {
+            return mid;
+        } else if (baud_table[mid].baud < value) {
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+
+    return -1;
+}
+
+int _uart_baud_valid(int value)
+{
+    if (baud_lookup(value) != -1)
         return 1;
-    
+
+#ifdef __linux__
+    /* any other positive baud rate is set with termios2 (BOTHER) */
+    if (value > 0)
+        return 1;
+#endif
+
     return 0;
 }
 
-int _uart_init_baud(struct _uart_ctx *ctx, struct _uart *uart)
+#ifdef __linux__
+static int read_icount(int fd, struct uart_counters *counters)
 {
     int ret;
-    struct termios options;
-    
-    if (!ctx) {
-        return UART_ECTX;
+    struct serial_icounter_struct icount;
+
+    memset(&icount, 0, sizeof(icount));
+    ret = ioctl(fd, TIOCGICOUNT, &icount);
+
+    if (ret == -1) {
+        return -1;
     }
 
-    if (!uart) {
-        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+    /* kernel counters are plain int and wrap around */
+    counters->rx = (unsigned int) icount.rx;
+    counters->tx = (unsigned int) icount.tx;
+    counters->frame = (unsigned int) icount.frame;
+    counters->overrun = (unsigned int) icount.overrun;
+    counters->parity = (unsigned int) icount.parity;
+    counters->brk = (unsigned int) icount.brk;
+    counters->buf_overrun = (unsigned int) icount.buf_overrun;
 
-        return UART_EHANDLE;
+    return 0;
+}
+#endif
+
+static int termios_baud(struct _uart_ctx *ctx, struct _uart *uart, struct termios *options)
+{
+    int ret;
+    int i;
+
+    i = baud_lookup((int) uart->baud);
+
+    if (i == -1) {
+#ifdef __linux__
+        /* custom baud rate, applied with termios2 by termios_apply() */
+        if ((int) uart->baud > 0) {
+            return UART_ESUCCESS;
+        }
+#endif
+        _uart_error(ctx, uart, UART_EBAUD, NULL, NULL);
+
+        return UART_EBAUD;
     }
 
-    ret = tcgetattr(uart->fd, &options);
-    
+    ret = cfsetispeed(options, baud_table[i].speed);
+
     if (ret == -1) {
-        _uart_error(ctx, uart, UART_ESYSAPI, "tcgetattr", NULL);
+        _uart_error(ctx, uart, UART_ESYSAPI, "cfsetispeed", NULL);
 
         return UART_ESYSAPI;
     }
-    
-    switch (uart->baud) {
-    case UART_BAUD_0:
-        ret = cfsetispeed(&options, B0);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetispeed", NULL);
 
-            return UART_ESYSAPI;
-        }
-        
-        ret = cfsetospeed(&options, B0);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetospeed", NULL);
+    ret = cfsetospeed(options, baud_table[i].speed);
 
-            return UART_ESYSAPI;
-        }
+    if (ret == -1) {
+        _uart_error(ctx, uart, UART_ESYSAPI, "cfsetospeed", NULL);
+
+        return UART_ESYSAPI;
+    }
+
+    return UART_ESUCCESS;
+}
 
+static int termios_databits(struct _uart_ctx *ctx, struct _uart *uart, struct termios *options)
+{
+    switch (uart->data_bits) {
+    case UART_DATA_5:
+        options->c_cflag &= ~CSIZE;
+        options->c_cflag |= CS5;
         break;
-    case UART_BAUD_50:
-        ret = cfsetispeed(&options, B50);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetispeed", NULL);
+    case UART_DATA_6:
+        options->c_cflag &= ~CSIZE;
+        options->c_cflag |= CS6;
+        break;
+    case UART_DATA_7:
+        options->c_cflag &= ~CSIZE;
+        options->c_cflag |= CS7;
+        break;
+    case UART_DATA_8:
+        options->c_cflag &= ~CSIZE;
+        options->c_cflag |= CS8;
+        break;
+    default:
+        _uart_error(ctx, uart, UART_EDATA, NULL, "unsupported");
 
-            return UART_ESYSAPI;
-        }
-        
-        ret = cfsetospeed(&options, B50);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetospeed", NULL);
+        return UART_EDATA;
+    }
 
-            return UART_ESYSAPI;
-        }
+    return UART_ESUCCESS;
+}
+
+static int termios_parity(struct _uart_ctx *ctx, struct _uart *uart, struct termios *options)
+{
+    /* mark/space parity (CMSPAR) isn't POSIX, only Linux has it */
+#ifdef CMSPAR
+    options->c_cflag &= ~CMSPAR;
+#endif
 
+    switch (uart->parity) {
+    case UART_PARITY_NONE:
+        options->c_cflag &= ~PARENB;
         break;
-    case UART_BAUD_75:
-        ret = cfsetispeed(&options, B75);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetispeed", NULL);
+    case UART_PARITY_ODD:
+        options->c_cflag |= PARENB;
+        options->c_cflag |= PARODD;
+        break;
+    case UART_PARITY_EVEN:
+        options->c_cflag |= PARENB;
+        options->c_cflag &= ~PARODD;
+        break;
+#ifdef CMSPAR
+    case UART_PARITY_MARK:
+        options->c_cflag |= (PARENB | CMSPAR);
+        options->c_cflag |= PARODD;
+        break;
+    case UART_PARITY_SPACE:
+        options->c_cflag |= (PARENB | CMSPAR);
+        options->c_cflag &= ~PARODD;
+        break;
+#endif
+    default:
+        _uart_error(ctx, uart, UART_EPARITY, NULL, "unsupported");
 
-            return UART_ESYSAPI;
-        }
-        
-        ret = cfsetospeed(&options, B75);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetospeed", NULL);
+        return UART_EPARITY;
+    }
 
-            return UART_ESYSAPI;
-        }
+    return UART_ESUCCESS;
+}
 
+static int termios_stopbits(struct _uart_ctx *ctx, struct _uart *uart, struct termios *options)
+{
+    switch (uart->stop_bits) {
+    case UART_STOP_1_0:
+        options->c_cflag &= ~CSTOPB;
         break;
-    case UART_BAUD_110:
-        ret = cfsetispeed(&options, B110);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetispeed", NULL);
+    case UART_STOP_2_0:
+        options->c_cflag |= CSTOPB;
+        break;
+    default:
+        _uart_error(ctx, uart, UART_ESTOP, NULL, "unsupported");
 
-            return UART_ESYSAPI;
-        }
-        
-        ret = cfsetospeed(&options, B110);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetospeed", NULL);
+        return UART_ESTOP;
+    }
 
-            return UART_ESYSAPI;
-        }
-        
+    return UART_ESUCCESS;
+}
+
+static int termios_flow(struct _uart_ctx *ctx, struct _uart *uart, struct termios *options)
+{
+    switch (uart->flow_ctrl) {
+    case UART_FLOW_NO:
+        options->c_iflag &= ~(IXON | IXOFF | IXANY);
+        options->c_cflag &= ~CRTSCTS;
         break;
-    case UART_BAUD_134:
-        ret = cfsetispeed(&options, B134);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetispeed", NULL);
+    case UART_FLOW_SW:
+        options->c_iflag |= (IXON | IXOFF | IXANY);
+        options->c_cflag &= ~CRTSCTS;
+        break;
+    case UART_FLOW_HW:
+        options->c_iflag &= ~(IXON | IXOFF | IXANY);
+        options->c_cflag |= CRTSCTS;
+        break;
+    default:
+        _uart_error(ctx, uart, UART_EFLOW, NULL, "unsupported");
 
-            return UART_ESYSAPI;
-        }
-        
-        ret = cfsetospeed(&options, B134);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetospeed", NULL);
+        return UART_EFLOW;
+    }
 
-            return UART_ESYSAPI;
-        }
+    return UART_ESUCCESS;
+}
+
+static int termios_apply(struct _uart_ctx *ctx, struct _uart *uart, struct termios *options, int drain)
+{
+    int ret;
+
+#ifdef __linux__
+    if (baud_lookup((int) uart->baud) == -1) {
+        ret = baud_set_custom(uart->fd,
+                              options->c_iflag,
+                              options->c_oflag,
+                              options->c_cflag,
+                              options->c_lflag,
+                              options->c_cc,
+                              NCCS,
+                              (int) uart->baud,
+                              drain);
 
-        break;
-    case UART_BAUD_150:
-        ret = cfsetispeed(&options, B150);
-        
         if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetispeed", NULL);
+            _uart_error(ctx, uart, UART_ESYSAPI, "ioctl", "TCSETS2");
 
             return UART_ESYSAPI;
         }
-        
-        ret = cfsetospeed(&options, B150);
-        
+    } else {
+        ret = tcsetattr(uart->fd, (drain) ? TCSADRAIN : TCSANOW, options);
+
         if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetospeed", NULL);
+            _uart_error(ctx, uart, UART_ESYSAPI, "tcsetattr", NULL);
 
             return UART_ESYSAPI;
         }
+    }
+#else
+    ret = tcsetattr(uart->fd, (drain) ? TCSADRAIN : TCSANOW, options);
+
+    if (ret == -1) {
+        _uart_error(ctx, uart, UART_ESYSAPI, "tcsetattr", NULL);
+
+        return UART_ESYSAPI;
+    }
+#endif
+
+    /* keep the shadow in sync with the applied line settings */
+    uart->tio = *(options);
+
+    return UART_ESUCCESS;
+}
+
+int _uart_init_baud(struct _uart_ctx *ctx, struct _uart *uart)
+{
+    int ret;
+    struct termios options;
+    
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+    options = uart->tio;
+    ret = termios_baud(ctx, uart, &options);
+
+    if (ret != UART_ESUCCESS) {
+        return ret;
+    }
+
+    return termios_apply(ctx, uart, &options, 0);
+}
+
+int _uart_init_databits(struct _uart_ctx *ctx, struct _uart *uart)
+{
+    int ret;
+    struct termios options;
+    
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+    options = uart->tio;
+    ret = termios_databits(ctx, uart, &options);
+
+    if (ret != UART_ESUCCESS) {
+        return ret;
+    }
+
+    return termios_apply(ctx, uart, &options, 0);
+}
+
+int _uart_init_parity(struct _uart_ctx *ctx, struct _uart *uart)
+{
+    int ret;
+    struct termios options;
+    
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+    options = uart->tio;
+    ret = termios_parity(ctx, uart, &options);
+
+    if (ret != UART_ESUCCESS) {
+        return ret;
+    }
+
+    return termios_apply(ctx, uart, &options, 0);
+}
+
+int _uart_init_stopbits(struct _uart_ctx *ctx, struct _uart *uart)
+{
+    int ret;
+    struct termios options;
+    
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+    options = uart->tio;
+    ret = termios_stopbits(ctx, uart, &options);
+
+    if (ret != UART_ESUCCESS) {
+        return ret;
+    }
+
+    return termios_apply(ctx, uart, &options, 0);
+}
+
+int _uart_init_flow(struct _uart_ctx *ctx, struct _uart *uart)
+{
+    int ret;
+    struct termios options;
+    
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+    options = uart->tio;
+    ret = termios_flow(ctx, uart, &options);
+
+    if (ret != UART_ESUCCESS) {
+        return ret;
+    }
+
+    return termios_apply(ctx, uart, &options, 0);
+}
+
+int _uart_configure(struct _uart_ctx *ctx, struct _uart *uart, int drain)
+{
+    int ret;
+    struct termios options;
+
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+    /**
+     * Build the complete line configuration on a copy of the shadow
+     * and apply it with a single call, so the line is never left in
+     * a half-configured state.
+     */
+    options = uart->tio;
+    ret = termios_baud(ctx, uart, &options);
+
+    if (ret != UART_ESUCCESS) {
+        return ret;
+    }
+
+    ret = termios_databits(ctx, uart, &options);
+
+    if (ret != UART_ESUCCESS) {
+        return ret;
+    }
+
+    ret = termios_parity(ctx, uart, &options);
+
+    if (ret != UART_ESUCCESS) {
+        return ret;
+    }
+
+    ret = termios_stopbits(ctx, uart, &options);
+
+    if (ret != UART_ESUCCESS) {
+        return ret;
+    }
+
+    ret = termios_flow(ctx, uart, &options);
+
+    if (ret != UART_ESUCCESS) {
+        return ret;
+    }
+
+    return termios_apply(ctx, uart, &options, drain);
+}
+
+int _uart_init(struct _uart_ctx *ctx)
+{
+    int ret;
+    int i;
+    gid_t g_list[256];
+    struct group *g;
+
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    ret = getgroups(256, g_list);
+
+    if (ret == -1) {
+        _uart_error(ctx, NULL, UART_ESYSAPI, "getgroups", NULL);
+
+        return UART_ESYSAPI;
+    }
+
+#ifdef __linux__
+    /**
+     * User must be in group 'dialout' for using the UART on Linux
+     */
+    g = getgrnam("dialout");
+#elif __FreeBSD__
+    /**
+     * User must be in group 'dialer' for using the UART on FreeBSD
+     */
+    g = getgrnam("dialer");
+#else
+#error "Unsupported POSIX compatible operating system."
+#endif
+
+    if (!g) {
+        _uart_error(ctx, NULL, UART_ESYSAPI, "getgrnam", NULL);
+
+        return UART_ESYSAPI;
+    }
+
+    for (i = 0; i < ret; i++) {
+        if (g_list[i] == g->gr_gid) {
+            ctx->flags |= UART_CTXFOKAY;
+            return UART_ESUCCESS;;
+        }
+    }
+
+    return UART_EPERM;
+}
+
+/**
+ * Report a found device to the device list scan
+ */
+static int device_add(struct _uart_ctx *ctx, const char *name)
+{
+    char dev[UART_NAMEMAX];
+
+    snprintf(dev, UART_NAMEMAX, "/dev/%s", name);
+
+    return _uart_device_found(ctx, dev);
+}
+
+#ifdef __linux__
+#define PREFIX_INIT     64
+
+struct prefix_entry {
+    char *prefix;
+    size_t len;
+    int next;
+};
+
+/**
+ * Serial driver name prefixes (from '/proc/tty/drivers'), chained by
+ * the first character of the prefix
+ */
+struct prefix_index {
+    struct prefix_entry *entry;
+    int size;
+    int count;
+    int head[256];
+};
+
+/**
+ * Read a whole (proc) file at once, the size of these files is unknown
+ */
+static char *file_read(const char *path, size_t *ret_len)
+{
+    int fd;
+    char *data;
+    char *tmp;
+    size_t size = 4096;
+    size_t len = 0;
+    ssize_t ret;
+
+    fd = open(path, O_RDONLY);
+
+    if (fd == -1) {
+        return NULL;
+    }
+
+    data = (char *) malloc(size + 1);
+
+    while (data) {
+        ret = read(fd, data + len, size - len);
+
+        if (ret == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            free(data);
+            data = NULL;
+
+            break;
+        }
+
+        if (ret == 0) {
+            break;
+        }
+
+        len += (size_t) ret;
+
+        if (len == size) {
+            size *= 2;
+            tmp = (char *) realloc(data, size + 1);
+
+            if (!tmp) {
+                free(data);
+            }
+
+            data = tmp;
+        }
+    }
+
+    close(fd);
+
+    if (data) {
+        data[len] = '\0';
+        *(ret_len) = len;
+    }
+
+    return data;
+}
+
+/**
+ * Build the prefix index from the serial drivers in '/proc/tty/drivers'
+ *
+ * Each line has the fields: name, device path, major, minor range, type.
+ * The table grows with the number of drivers, the caller frees entry.
+ */
+static int prefix_index_build(struct prefix_index *idx, char *data, size_t len)
+{
+    char *line = data;
+    char *end;
+    char *field[5];
+    char *name;
+    char *save;
+    struct prefix_entry *tmp;
+    int num;
+    unsigned char c;
+
+    memset(idx->head, -1, sizeof(idx->head));
+    idx->entry = NULL;
+    idx->size = 0;
+    idx->count = 0;
+
+    while (line < data + len) {
+        end = strchr(line, '\n');
+
+        if (end) {
+            *end = '\0';
+        }
+
+        num = 0;
+        field[num] = strtok_r(line, " \t", &save);
+
+        while (field[num] && (num < 4)) {
+            field[++num] = strtok_r(NULL, " \t", &save);
+        }
+
+        if ((num == 4) && field[4] && (strcmp(field[4], "serial") == 0)) {
+            if (idx->count == idx->size) {
+                num = (idx->size) ? idx->size * 2 : PREFIX_INIT;
+                tmp = (struct prefix_entry *) realloc(idx->entry, num * sizeof(*tmp));
+
+                if (!tmp) {
+                    return UART_ENOMEM;
+                }
+
+                idx->entry = tmp;
+                idx->size = num;
+            }
+
+            name = strrchr(field[1], '/');
+            name = (name) ? name + 1 : field[1];
+            c = (unsigned char) name[0];
+
+            idx->entry[idx->count].prefix = name;
+            idx->entry[idx->count].len = strlen(name);
+            idx->entry[idx->count].next = idx->head[c];
+            idx->head[c] = idx->count;
+            idx->count++;
+        }
+
+        if (!end) {
+            break;
+        }
+
+        line = end + 1;
+    }
+
+    return UART_ESUCCESS;
+}
+
+/**
+ * Test if a tty name is a driver prefix followed by the port number
+ */
+static int prefix_index_match(struct prefix_index *idx, const char *name)
+{
+    int i;
+    const char *p;
+
+    for (i = idx->head[(unsigned char) name[0]]; i != -1; i = idx->entry[i].next) {
+        if (strncmp(name, idx->entry[i].prefix, idx->entry[i].len) != 0) {
+            continue;
+        }
+
+        p = name + idx->entry[i].len;
+
+        if (*p == '\0') {
+            continue;
+        }
+
+        while ((*p >= '0') && (*p <= '9')) {
+            p++;
+        }
+
+        if (*p == '\0') {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+#endif
+
+int _uart_get_device_list(struct _uart_ctx *ctx)
+{
+#ifdef __linux__
+    char *data;
+    size_t len;
+    struct prefix_index idx;
+    int ret = UART_ESUCCESS;
+    DIR *dir;
+    struct dirent *entry;
+#elif __FreeBSD__
+    DIR *dir;
+    struct dirent *entry;
+#else
+#error "Unsupported POSIX compatible operating system."
+#endif
+
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+#ifdef __linux__
+    /**
+     * Parse file '/proc/tty/drivers' for available UART drivers
+     */
+    data = file_read("/proc/tty/drivers", &len);
+
+    if (!data) {
+        _uart_error(ctx, NULL, UART_ESYSAPI, "open", "/proc/tty/drivers");
+
+        return UART_ESYSAPI;
+    }
+
+    ret = prefix_index_build(&idx, data, len);
+
+    if (ret != UART_ESUCCESS) {
+        free(idx.entry);
+        free(data);
+        _uart_error(ctx, NULL, ret, NULL, NULL);
+
+        return ret;
+    }
+
+    if (idx.count == 0) {
+        free(idx.entry);
+        free(data);
+        _uart_error(ctx, NULL, UART_EDEV, NULL, "no UART devices found");
+
+        return UART_EDEV;
+    }
+
+    /**
+     * Parse directory '/sys/class/tty' for available UART's
+     */
+    dir = opendir("/sys/class/tty");
+
+    if (!dir) {
+        free(idx.entry);
+        free(data);
+        _uart_error(ctx, NULL, UART_ESYSAPI, "opendir", NULL);
+
+        return UART_ESYSAPI;
+    }
+
+    entry = readdir(dir);
+
+    while (entry) {
+        if (prefix_index_match(&idx, entry->d_name)) {
+            ret = device_add(ctx, entry->d_name);
+
+            if (ret != UART_ESUCCESS) {
+                break;
+            }
+        }
+
+        entry = readdir(dir);
+    }
+
+    closedir(dir);
+    free(idx.entry);
+    free(data);
+
+    if (ret != UART_ESUCCESS) {
+        return ret;
+    }
+#elif __FreeBSD__
+    /**
+     * Parse directory '/dev' for available UART's
+     */
+    dir = opendir("/dev");
+
+    if (!dir) {
+        _uart_error(ctx, NULL, UART_ESYSAPI, "opendir", NULL);
+
+        return UART_ESYSAPI;
+    }
+
+    entry = readdir(dir);
+
+    while (entry) {
+        if (strncmp(entry->d_name, "cuau", strlen("cuau")) == 0) {
+            if ((strnrcmp(entry->d_name, ".init", strlen(".init")) != 0) &&
+                (strnrcmp(entry->d_name, ".lock", strlen(".lock")) != 0)) {
+                if (device_add(ctx, entry->d_name) != UART_ESUCCESS) {
+                    closedir(dir);
+
+                    return UART_ENOMEM;
+                }
+            }
+        }
+
+        entry = readdir(dir);
+    }
+
+    closedir(dir);
+#else
+#error "Unsupported POSIX compatible operating system."
+#endif
+
+    return UART_ESUCCESS;
+}
+
+#ifdef __linux__
+/**
+ * Read a sysfs attribute (first line) into buf
+ *
+ * Returns 0 on success and -1 if the attribute doesn't exist.
+ */
+static int sysfs_read_str(const char *dir, const char *attr, char *buf, size_t size)
+{
+    char path[PATH_MAX];
+    ssize_t ret;
+    int fd;
+
+    snprintf(path, sizeof(path), "%s/%s", dir, attr);
+    fd = open(path, O_RDONLY);
+
+    if (fd == -1) {
+        return -1;
+    }
+
+    ret = read(fd, buf, size - 1);
+    close(fd);
+
+    if (ret < 0) {
+        return -1;
+    }
+
+    buf[ret] = '\0';
+    buf[strcspn(buf, "\n")] = '\0';
+
+    return 0;
+}
+
+static void info_copy(char *dst, const char *src)
+{
+    strncpy(dst, src, UART_INFOMAX - 1);
+    dst[UART_INFOMAX - 1] = '\0';
+}
+
+/**
+ * Get the driver of the tty's device, newer kernels put generic serial
+ * core devices (port, ctrl) between the tty and the hardware
+ */
+static void driver_name(const char *name, struct uart_dev_info *info)
+{
+    char path[PATH_MAX + 16];
+    char dev[PATH_MAX];
+    char link[PATH_MAX];
+    const char *drv;
+    char *p;
+    ssize_t len;
+    int depth;
+
+    snprintf(path, sizeof(path), "/sys/class/tty/%s/device", name);
+
+    if (!realpath(path, dev)) {
+        return;
+    }
+
+    for (depth = 0; depth < 4; depth++) {
+        snprintf(path, sizeof(path), "%s/driver", dev);
+        len = readlink(path, link, sizeof(link) - 1);
+
+        if (len > 0) {
+            link[len] = '\0';
+            drv = strrchr(link, '/') ? strrchr(link, '/') + 1 : link;
+
+            if ((strcmp(drv, "port") != 0) && (strcmp(drv, "ctrl") != 0)) {
+                info_copy(info->driver, drv);
+
+                break;
+            }
+        }
+
+        p = strrchr(dev, '/');
+
+        if (!p || (p == dev)) {
+            break;
+        }
+
+        *p = '\0';
+    }
+}
+
+/**
+ * Walk from the tty's device up to the USB device (interface number
+ * from the interface, IDs and serial from the device itself)
+ */
+static void usb_info(const char *name, struct uart_dev_info *info)
+{
+    char path[PATH_MAX];
+    char dev[PATH_MAX];
+    char buf[UART_INFOMAX];
+    char *p;
+    int depth;
+
+    snprintf(path, sizeof(path), "/sys/class/tty/%s/device", name);
+
+    if (!realpath(path, dev)) {
+        return;
+    }
+
+    for (depth = 0; depth < 8; depth++) {
+        if ((info->interface == UART_INFO_ANY) &&
+            (sysfs_read_str(dev, "bInterfaceNumber", buf, sizeof(buf)) == 0)) {
+            info->interface = (int) strtol(buf, NULL, 16);
+        }
+
+        if (sysfs_read_str(dev, "idVendor", buf, sizeof(buf)) == 0) {
+            info->vid = (int) strtol(buf, NULL, 16);
+
+            if (sysfs_read_str(dev, "idProduct", buf, sizeof(buf)) == 0) {
+                info->pid = (int) strtol(buf, NULL, 16);
+            }
+
+            sysfs_read_str(dev, "serial", info->serial, sizeof(info->serial));
+
+            break;
+        }
+
+        p = strrchr(dev, '/');
+
+        if (!p || (p - dev <= (ptrdiff_t) strlen("/sys/devices"))) {
+            break;
+        }
+
+        *p = '\0';
+    }
+}
+
+/**
+ * Assign the stable links of a '/dev/serial' directory to the devices
+ */
+static void serial_links(const char *dir, struct _uart **uarts, char (*real)[PATH_MAX], int count, int by_id)
+{
+    DIR *d;
+    struct dirent *entry;
+    char path[PATH_MAX];
+    char target[PATH_MAX];
+    int i;
+
+    d = opendir(dir);
+
+    if (!d) {
+        return;
+    }
+
+    while ((entry = readdir(d)) != NULL) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+
+        snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+
+        if (!realpath(path, target)) {
+            continue;
+        }
+
+        for (i = 0; i < count; i++) {
+            if (strcmp(target, real[i]) == 0) {
+                if (by_id) {
+                    info_copy(uarts[i]->info.by_id, path);
+                } else {
+                    info_copy(uarts[i]->info.by_path, path);
+                }
+            }
+        }
+    }
+
+    closedir(d);
+}
+#endif
+
+void _uart_get_device_info(struct _uart_ctx *ctx, struct _uart **uarts, int count)
+{
+#ifdef __linux__
+    char (*real)[PATH_MAX];
+    const char *name;
+#endif
+    struct uart_dev_info *info;
+    int i;
+
+    if (!ctx || (count <= 0)) {
+        return;
+    }
+
+    for (i = 0; i < count; i++) {
+        info = &uarts[i]->info;
+        memset(info, 0, sizeof(struct uart_dev_info));
+        info->vid = UART_INFO_ANY;
+        info->pid = UART_INFO_ANY;
+        info->interface = UART_INFO_ANY;
+        uarts[i]->flags |= UART_FINFO;
+    }
+
+#ifdef __linux__
+    real = malloc((size_t) count * sizeof(*real));
+
+    if (!real) {
+        return;
+    }
+
+    for (i = 0; i < count; i++) {
+        info = &uarts[i]->info;
+
+        if (!realpath(uarts[i]->dev, real[i])) {
+            snprintf(real[i], PATH_MAX, "%s", uarts[i]->dev);
+        }
+
+        name = strrchr(real[i], '/') ? strrchr(real[i], '/') + 1 : real[i];
+
+        driver_name(name, info);
+        usb_info(name, info);
+    }
+
+    /* the link directories are read once for all devices */
+    serial_links("/dev/serial/by-id", uarts, real, count, 1);
+    serial_links("/dev/serial/by-path", uarts, real, count, 0);
+
+    free(real);
+#endif
+}
+
+int _uart_hotplug_open(struct _uart_ctx *ctx)
+{
+#ifdef __linux__
+    int fd;
+    struct sockaddr_nl addr;
+#endif
+
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+#ifdef __linux__
+    /* kernel uevents, no udev required */
+    fd = socket(AF_NETLINK, SOCK_DGRAM, NETLINK_KOBJECT_UEVENT);
+
+    if (fd == -1) {
+        _uart_error(ctx, NULL, UART_ESYSAPI, "socket", "NETLINK_KOBJECT_UEVENT");
+
+        return UART_ESYSAPI;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = 1;
+
+    if ((fcntl(fd, F_SETFL, O_NONBLOCK) == -1) ||
+        (fcntl(fd, F_SETFD, FD_CLOEXEC) == -1) ||
+        (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) == -1)) {
+        _uart_error(ctx, NULL, UART_ESYSAPI, "bind", "NETLINK_KOBJECT_UEVENT");
+        close(fd);
+
+        return UART_ESYSAPI;
+    }
+
+    ctx->hotplug_fd = fd;
+
+    return UART_ESUCCESS;
+#else
+    _uart_error(ctx, NULL, UART_ENOTSUP, NULL, "hotplug");
+
+    return UART_ENOTSUP;
+#endif
+}
+
+#ifdef __linux__
+/**
+ * Test if an uevent message adds or removes a tty
+ *
+ * The message is a header ("action@devpath") followed by NUL terminated
+ * KEY=value pairs.
+ */
+static int uevent_tty(const char *msg, size_t len)
+{
+    const char *p = msg;
+    const char *end = msg + len;
+    int action = 0;
+    int tty = 0;
+
+    while (p < end) {
+        if ((strcmp(p, "ACTION=add") == 0) || (strcmp(p, "ACTION=remove") == 0)) {
+            action = 1;
+        } else if (strcmp(p, "SUBSYSTEM=tty") == 0) {
+            tty = 1;
+        }
+
+        p += strlen(p) + 1;
+    }
+
+    return action && tty;
+}
+#endif
+
+int _uart_hotplug_read(struct _uart_ctx *ctx)
+{
+#ifdef __linux__
+    char buf[8192];
+    struct sockaddr_nl addr;
+    struct iovec iov;
+    struct msghdr msg;
+    ssize_t ret;
+    int events = 0;
+#endif
+
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+#ifdef __linux__
+    for (;;) {
+        iov.iov_base = buf;
+        iov.iov_len = sizeof(buf) - 1;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_name = &addr;
+        msg.msg_namelen = sizeof(addr);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+
+        ret = recvmsg(ctx->hotplug_fd, &msg, 0);
+
+        if (ret == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+                break;
+            }
+
+            /* events were dropped, rescan anyway */
+            if (errno == ENOBUFS) {
+                events++;
+
+                continue;
+            }
+
+            _uart_error(ctx, NULL, UART_ESYSAPI, "recvmsg", NULL);
+
+            return UART_ESYSAPI;
+        }
+
+        /* only messages from the kernel */
+        if (addr.nl_pid != 0) {
+            continue;
+        }
+
+        buf[ret] = '\0';
+
+        if (uevent_tty(buf, (size_t) ret)) {
+            events++;
+        }
+    }
+
+    return events;
+#else
+    _uart_error(ctx, NULL, UART_ENOTSUP, NULL, "hotplug");
+
+    return UART_ENOTSUP;
+#endif
+}
+
+void _uart_hotplug_close(struct _uart_ctx *ctx)
+{
+    if (ctx->hotplug_fd != -1) {
+        close(ctx->hotplug_fd);
+        ctx->hotplug_fd = -1;
+    }
+}
+
+#define UART_LOCKDIR            "/var/lock"
+
+/**
+ * UUCP style lock file of a device ('LCK..' and the kernel tty name)
+ */
+static void lock_path(const char *dev, char *path, size_t size)
+{
+    char real[PATH_MAX];
+    const char *name;
+
+    if (!realpath(dev, real)) {
+        strncpy(real, dev, sizeof(real) - 1);
+        real[sizeof(real) - 1] = '\0';
+    }
+
+    name = strrchr(real, '/') ? strrchr(real, '/') + 1 : real;
+    snprintf(path, size, "%s/LCK..%.64s", UART_LOCKDIR, name);
+}
+
+/**
+ * Get the PID from a UUCP lock file, 0 if there is no (live) owner
+ */
+static int lock_file_owner(const char *path)
+{
+    char buf[32];
+    ssize_t ret;
+    int fd;
+    int pid;
+
+    fd = open(path, O_RDONLY);
+
+    if (fd == -1) {
+        return 0;
+    }
+
+    ret = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+
+    if (ret <= 0) {
+        return 0;
+    }
+
+    buf[ret] = '\0';
+    pid = atoi(buf);
+
+    if ((pid <= 0) || ((kill(pid, 0) == -1) && (errno == ESRCH))) {
+        return 0;
+    }
+
+    return pid;
+}
+
+/**
+ * Get the PID holding a flock on the device from '/proc/locks'
+ */
+static int flock_owner(const char *dev)
+{
+#ifdef __linux__
+    struct stat st;
+    char *data;
+    char *line;
+    char *end;
+    char type[16];
+    unsigned int maj;
+    unsigned int min;
+    unsigned long ino;
+    size_t len;
+    int pid;
+    int owner = 0;
+
+    if (stat(dev, &st) == -1) {
+        return 0;
+    }
+
+    data = file_read("/proc/locks", &len);
+
+    if (!data) {
+        return 0;
+    }
+
+    /* e.g. "1: FLOCK  ADVISORY  WRITE 1234 00:05:87 0 EOF" */
+    for (line = data; line && (line < data + len); line = end) {
+        end = strchr(line, '\n');
+
+        if (end) {
+            *end++ = '\0';
+        }
+
+        if (sscanf(line, "%*d: %15s %*s %*s %d %x:%x:%lu", type, &pid, &maj, &min, &ino) != 5) {
+            continue;
+        }
+
+        if ((strcmp(type, "FLOCK") == 0) && (maj == major(st.st_dev)) &&
+            (min == minor(st.st_dev)) && (ino == (unsigned long) st.st_ino)) {
+            owner = pid;
+
+            break;
+        }
+    }
+
+    free(data);
+
+    return owner;
+#else
+    (void) dev;
+
+    return 0;
+#endif
+}
+
+/**
+ * Create the UUCP lock file of a device (opened by dev)
+ *
+ * A stale lock (owner doesn't exist anymore) is replaced. Without a
+ * writable lock directory only the other locks are used.
+ */
+static int lock_create(struct _uart_ctx *ctx, struct _uart *uart, const char *dev)
+{
+    char path[UART_NAMEMAX];
+    char buf[16];
+    int retry;
+    int fd;
+    int len;
+
+    lock_path(dev, path, sizeof(path));
+
+    for (retry = 0; retry < 2; retry++) {
+        fd = open(path, O_WRONLY | O_CREAT | O_EXCL, 0644);
+
+        if (fd != -1) {
+            len = snprintf(buf, sizeof(buf), "%10d\n", (int) getpid());
+
+            if (write(fd, buf, (size_t) len) != len) {
+                close(fd);
+                unlink(path);
+                _uart_error(ctx, uart, UART_ESYSAPI, "write", path);
+
+                return UART_ESYSAPI;
+            }
+
+            close(fd);
+            strcpy(uart->lock, path);
+
+            return UART_ESUCCESS;
+        }
+
+        if (errno != EEXIST) {
+            return UART_ESUCCESS;
+        }
+
+        uart->owner = lock_file_owner(path);
+
+        if (uart->owner) {
+            return UART_EBUSY;
+        }
+
+        unlink(path);
+    }
+
+    return UART_EBUSY;
+}
+
+static void lock_release(struct _uart *uart)
+{
+    if (uart->lock[0] != '\0') {
+        unlink(uart->lock);
+        uart->lock[0] = '\0';
+    }
+}
+
+/**
+ * Take exclusive access: UUCP lock file, TIOCEXCL and flock
+ */
+static int lock_device(struct _uart_ctx *ctx, struct _uart *uart, const char *dev)
+{
+    char msg[64];
+    int ret;
+
+    ret = lock_create(ctx, uart, dev);
+
+    if (ret == UART_EBUSY) {
+        snprintf(msg, sizeof(msg), "locked by PID %d", uart->owner);
+        _uart_error(ctx, uart, UART_EBUSY, NULL, msg);
+
+        return UART_EBUSY;
+    }
+
+    if (ret != UART_ESUCCESS) {
+        return ret;
+    }
+
+    if (flock(uart->fd, LOCK_EX | LOCK_NB) == -1) {
+        lock_release(uart);
+
+        if (errno == EWOULDBLOCK) {
+            uart->owner = flock_owner(dev);
+            snprintf(msg, sizeof(msg), "locked by PID %d", uart->owner);
+            _uart_error(ctx, uart, UART_EBUSY, "flock", msg);
+
+            return UART_EBUSY;
+        }
+
+        _uart_error(ctx, uart, UART_ESYSAPI, "flock", NULL);
+
+        return UART_ESYSAPI;
+    }
+
+    if (ioctl(uart->fd, TIOCEXCL) == -1) {
+        lock_release(uart);
+        _uart_error(ctx, uart, UART_ESYSAPI, "ioctl", "TIOCEXCL");
+
+        return UART_ESYSAPI;
+    }
+
+    return UART_ESUCCESS;
+}
+
+/**
+ * Undo the open (and the locks) after a failed configuration
+ */
+static void open_fail(struct _uart *uart)
+{
+    if (uart->exclusive) {
+        lock_release(uart);
+    }
+
+    close(uart->fd);
+    uart->fd = -1;
+}
+
+/**
+ * Get the PID of the process with exclusive access (lock file or
+ * flock), 0 if unknown
+ */
+static int device_owner(const char *dev)
+{
+    char path[UART_NAMEMAX];
+    int pid;
+
+    lock_path(dev, path, sizeof(path));
+    pid = lock_file_owner(path);
+
+    if (pid == 0) {
+        pid = flock_owner(dev);
+    }
+
+    return pid;
+}
+
+int _uart_get_owner(struct _uart_ctx *ctx, const char *dev, int *pid)
+{
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    *(pid) = device_owner(dev);
+
+    return UART_ESUCCESS;
+}
+
+int _uart_open(struct _uart_ctx *ctx, struct _uart *uart)
+{
+    char msg[64];
+    int ret;
+    int fd;
+    
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+    uart->lock[0] = '\0';
+    uart->owner = 0;
+    fd = open(uart->dev, O_RDWR | O_NOCTTY | O_NDELAY);
+    
+    if (fd == -1) {
+        /* another process opened the device with TIOCEXCL */
+        if (errno == EBUSY) {
+            uart->owner = device_owner(uart->dev);
+
+            if (uart->owner) {
+                snprintf(msg, sizeof(msg), "exclusive, locked by PID %d", uart->owner);
+            } else {
+                snprintf(msg, sizeof(msg), "exclusive");
+            }
+
+            _uart_error(ctx, uart, UART_EBUSY, "open", msg);
+
+            return UART_EBUSY;
+        }
+
+        _uart_error(ctx, uart, UART_ESYSAPI, "open", NULL);
+
+        return UART_ESYSAPI;
+    }
+    
+    uart->fd = fd;
+
+    if (uart->exclusive) {
+        ret = lock_device(ctx, uart, uart->dev);
+
+        if (ret != UART_ESUCCESS) {
+            open_fail(uart);
+
+            return ret;
+        }
+    }
+
+    /* set non-blocking mode */
+    ret = fcntl(uart->fd, F_SETFL, O_NDELAY);
+
+    if (ret == -1) {
+        _uart_error(ctx, uart, UART_ESYSAPI, "fcntl", NULL);
+        open_fail(uart);
+
+        return UART_ESYSAPI;
+    }
+
+    ret = tcgetattr(uart->fd, &uart->tio);
+
+    if (ret == -1) {
+        _uart_error(ctx, uart, UART_ESYSAPI, "tcgetattr", NULL);
+        open_fail(uart);
+
+        return UART_ESYSAPI;
+    }
+
+    /* set raw mode (see man cfmakeraw) */
+    uart->tio.c_lflag &= ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
+    uart->tio.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP |
+    INLCR | IGNCR | ICRNL | IXON);
+    uart->tio.c_oflag &= ~OPOST;
+    uart->tio.c_cflag &= ~(CSIZE | PARENB);
+    uart->tio.c_cflag |= CS8;
+
+    /* enable receiver and set local mode */
+    uart->tio.c_cflag |= (CLOCAL | CREAD);
+
+    /* set baud rate, data bits, parity, stop bits and flow control */
+    ret = _uart_configure(ctx, uart, 0);
+
+    if (ret != UART_ESUCCESS) {
+        open_fail(uart);
+
+        return ret;
+    }
+
+    /* start value for the counter differences (if supported by the driver) */
+    memset(&uart->counters, 0, sizeof(uart->counters));
+    memset(&uart->rs485, 0, sizeof(uart->rs485));
+    memset(&uart->flow, 0, sizeof(uart->flow));
+    uart->flow_since = 0;
+    uart->flow_pending = 0;
+    uart->md_addr = -1;
+    uart->md_selected = 0;
+    uart->rx_esc = 0;
+    uart->rx_errors = 0;
+    uart->rx_offset = 0;
+    uart->rx_err = NULL;
+    uart->rx_err_head = 0;
+    uart->rx_err_num = 0;
+    uart->rx_err_lost = 0;
+#ifdef __linux__
+    read_icount(uart->fd, &uart->counters);
+#endif
+    
+    return UART_ESUCCESS;
+}
+
+/**
+ * Put the failed device back after an unsuccessful reopen, so the
+ * descriptor number stays reserved and keeps failing
+ */
+static void reopen_fail(struct _uart *uart, int old)
+{
+    if (uart->exclusive) {
+        lock_release(uart);
+    }
+
+    dup2(old, uart->fd);
+    close(old);
+}
+
+int _uart_reopen(struct _uart_ctx *ctx, struct _uart *uart)
+{
+    const char *path = uart->dev;
+    struct uart_rs485 rs485;
+    int ret;
+    int fd;
+    int old;
+
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+    /* a USB adapter may come back with another tty name */
+    if ((uart->flags & UART_FINFO) && (uart->info.by_id[0] != '\0')) {
+        path = uart->info.by_id;
+    }
+
+    fd = open(path, O_RDWR | O_NOCTTY | O_NDELAY);
+
+    if (fd == -1) {
+        _uart_error(ctx, uart, UART_ESYSAPI, "open", path);
+
+        return UART_ESYSAPI;
+    }
+
+    old = dup(uart->fd);
+
+    if (old == -1) {
+        close(fd);
+        _uart_error(ctx, uart, UART_ESYSAPI, "dup", NULL);
+
+        return UART_ESYSAPI;
+    }
+
+    /**
+     * The old file may still hold the locks (same inode), a retry must
+     * not find itself as owner.
+     */
+    if (uart->exclusive) {
+        flock(old, LOCK_UN);
+        lock_release(uart);
+    }
+
+    /* keep the descriptor number, the workers and the application use it */
+    ret = dup2(fd, uart->fd);
+    close(fd);
+
+    if (ret == -1) {
+        close(old);
+        _uart_error(ctx, uart, UART_ESYSAPI, "dup2", NULL);
+
+        return UART_ESYSAPI;
+    }
+
+    /* the same locks as a normal open (lock file of the new tty name) */
+    if (uart->exclusive) {
+        ret = lock_device(ctx, uart, path);
+
+        if (ret != UART_ESUCCESS) {
+            reopen_fail(uart, old);
+
+            return ret;
+        }
+    }
+
+    /* the termios shadow holds the complete line configuration */
+    ret = _uart_configure(ctx, uart, 0);
+
+    if (ret != UART_ESUCCESS) {
+        reopen_fail(uart, old);
+
+        return ret;
+    }
+
+    if ((uart->rs485.flags & UART_RS485_ENABLED) && !(uart->rs485.flags & UART_RS485_SOFTWARE)) {
+        rs485 = uart->rs485;
+        ret = _uart_set_rs485(ctx, uart, &rs485);
+
+        if (ret != UART_ESUCCESS) {
+            reopen_fail(uart, old);
+
+            return ret;
+        }
+    }
+
+    close(old);
+
+    /* a new device starts with new counters and no partial escape */
+    uart->rx_esc = 0;
+    memset(&uart->counters, 0, sizeof(uart->counters));
+#ifdef __linux__
+    read_icount(uart->fd, &uart->counters);
+#endif
+
+    return UART_ESUCCESS;
+}
+
+int _uart_close(struct _uart_ctx *ctx, struct _uart *uart)
+{
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+    if (uart->exclusive) {
+        ioctl(uart->fd, TIOCNXCL);
+        lock_release(uart);
+    }
+
+    close(uart->fd);
+    uart->fd = -1;
+
+    if (uart->rx_err) {
+        free(uart->rx_err);
+        uart->rx_err = NULL;
+    }
+
+    return UART_ESUCCESS;
+}
+
+#ifndef LIBUART_THREADS
+ssize_t _uart_send(struct _uart_ctx *ctx, struct _uart *uart, void *send_buf, size_t len)
+{
+    ssize_t ret;
+    
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+    ret = write(uart->fd, send_buf, len);
+    
+    if (ret == -1) {
+        _uart_error(ctx, uart, UART_ESYSAPI, "write", NULL);
+
+        return UART_ESYSAPI;
+    }
+    
+    if (ret != (ssize_t) len) {
+        _uart_error(ctx, uart, UART_ESYSAPI, "write", "could not send all data");
+
+        return UART_ESYSAPI;
+    }
+    
+    _uart_flow_update(ctx, uart, 0);
+    uart->error = UART_ESUCCESS;
+
+    return ret;
+}
+
+ssize_t _uart_send_timeout(struct _uart_ctx *ctx, struct _uart *uart, void *send_buf, size_t len, int timeout)
+{
+    ssize_t ret;
+    size_t sent = 0;
+    long long deadline = 0;
+    long long wait;
+    struct pollfd pfd;
+    unsigned char *p;
+
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+    if (timeout >= 0) {
+        deadline = time_get_ms() + timeout;
+    }
+
+    p = (unsigned char *) send_buf;
+    pfd.fd = uart->fd;
+    pfd.events = POLLOUT;
+
+    /**
+     * Write as much as the kernel accepts and wait for free space
+     * in the output queue until all data is sent or the deadline
+     * expired. Already sent bytes are always reported.
+     */
+    while (sent < len) {
+        ret = write(uart->fd, p + sent, len - sent);
+
+        if (ret == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+                _uart_error(ctx, uart, UART_ESYSAPI, "write", NULL);
+
+                return (sent) ? (ssize_t) sent : UART_ESYSAPI;
+            }
+
+            ret = 0;
+        }
+
+        sent += (size_t) ret;
+
+        if (sent == len) {
+            break;
+        }
+
+        if (timeout < 0) {
+            wait = -1;
+        } else {
+            wait = deadline - time_get_ms();
+
+            if (wait <= 0) {
+                _uart_error(ctx, uart, UART_ETIMEOUT, NULL, "could not send all data");
+
+                return (ssize_t) sent;
+            }
+        }
+
+        _uart_flow_update(ctx, uart, 1);
+        ret = poll(&pfd, 1, (int) wait);
+        _uart_flow_update(ctx, uart, 1);
+
+        if ((ret == -1) && (errno != EINTR)) {
+            _uart_error(ctx, uart, UART_ESYSAPI, "poll", NULL);
+
+            return (sent) ? (ssize_t) sent : UART_ESYSAPI;
+        }
+    }
+
+    /* close a stop that ended with the last write */
+    _uart_flow_update(ctx, uart, 0);
+    uart->error = UART_ESUCCESS;
+
+    return (ssize_t) sent;
+}
+
+ssize_t _uart_sendv(struct _uart_ctx *ctx, struct _uart *uart, const struct iovec *iov, int iovcnt)
+{
+    ssize_t ret;
+    size_t len = 0;
+    int i;
+
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+    for (i = 0; i < iovcnt; i++) {
+        len += iov[i].iov_len;
+    }
+
+    ret = writev(uart->fd, iov, iovcnt);
+
+    if (ret == -1) {
+        _uart_error(ctx, uart, UART_ESYSAPI, "writev", NULL);
+
+        return UART_ESYSAPI;
+    }
+
+    if (ret != (ssize_t) len) {
+        _uart_error(ctx, uart, UART_ESYSAPI, "writev", "could not send all data");
+
+        return UART_ESYSAPI;
+    }
+
+    uart->error = UART_ESUCCESS;
+
+    return ret;
+}
+
+ssize_t _uart_recvv(struct _uart_ctx *ctx, struct _uart *uart, const struct iovec *iov, int iovcnt)
+{
+    ssize_t ret;
+
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+    /* the PARMRK decoding needs contiguous data */
+    if ((uart->md_addr >= 0) || uart->rx_errors) {
+        _uart_error(ctx, uart, UART_ENOTSUP, NULL, "multidrop mode or error records");
+
+        return UART_ENOTSUP;
+    }
+
+    ret = readv(uart->fd, iov, iovcnt);
+
+    if (ret == -1) {
+        _uart_error(ctx, uart, UART_ESYSAPI, "readv", NULL);
+
+        return UART_ESYSAPI;
+    }
+
+    uart->rx_offset += (unsigned long long) ret;
+    uart->error = UART_ESUCCESS;
+
+    return ret;
+}
+
+ssize_t _uart_recv(struct _uart_ctx *ctx, struct _uart *uart, void *recv_buf, size_t len)
+{
+    ssize_t ret = 0;
+    
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+    ret = read(uart->fd, recv_buf, len);
+    
+    if (ret == -1) {
+        _uart_error(ctx, uart, UART_ESYSAPI, "read", NULL);
+
+        return UART_ESYSAPI;
+    }
+
+    if ((uart->md_addr >= 0) || uart->rx_errors) {
+        ret = _uart_parmrk_filter(uart, (unsigned char *) recv_buf, ret);
+    }
+
+    /* position in the receive stream for the error records */
+    uart->rx_offset += (unsigned long long) ret;
+    uart->error = UART_ESUCCESS;
+
+    return ret;
+}
+#endif
+
+int _uart_flush(struct _uart_ctx *ctx, struct _uart *uart)
+{
+    int ret = 0;
+    
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+    /* fsync() doesn't wait for the transmission on a terminal */
+    ret = tcdrain(uart->fd);
+    
+    if (ret == -1) {
+        _uart_error(ctx, uart, UART_ESYSAPI, "tcdrain", NULL);
+
+        return UART_ESYSAPI;
+    }
+    
+    return UART_ESUCCESS;
+}
+
+int _uart_drain_discard(struct _uart_ctx *ctx, struct _uart *uart, int timeout)
+{
+    int ret;
+
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+    /**
+     * tcdrain() can block forever (e.g. CTS held low or hung up), so
+     * wait a bounded time and discard what couldn't be sent.
+     */
+    ret = _uart_drain(ctx, uart, timeout);
+
+    if (ret != UART_ESUCCESS) {
+        tcflush(uart->fd, TCOFLUSH);
+
+        return ret;
+    }
+
+    return UART_ESUCCESS;
+}
+
+int _uart_drain(struct _uart_ctx *ctx, struct _uart *uart, int timeout)
+{
+    int ret;
+    int bytes;
+    long long deadline = 0;
+    long long wait;
+#ifdef __linux__
+    int lsr;
+#endif
+
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+    if (timeout >= 0) {
+        deadline = time_get_ms() + timeout;
+    }
+
+    /**
+     * tcdrain() can't time out, so poll the output queue and sleep
+     * for about the time the remaining bytes need on the line.
+     */
+    while (1) {
+        ret = ioctl(uart->fd, TIOCOUTQ, &bytes);
 
-        break;
-    case UART_BAUD_200:
-        ret = cfsetispeed(&options, B200);
-        
         if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetispeed", NULL);
+            _uart_error(ctx, uart, UART_ESYSAPI, "ioctl", "TIOCOUTQ");
 
             return UART_ESYSAPI;
         }
-        
-        ret = cfsetospeed(&options, B200);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetospeed", NULL);
 
-            return UART_ESYSAPI;
-        }
+#ifdef __linux__
+        /* the output queue is empty, wait for the transmitter (shift register) */
+        if (bytes == 0) {
+            ret = ioctl(uart->fd, TIOCSERGETLSR, &lsr);
 
-        break;
-    case UART_BAUD_300:
-        ret = cfsetispeed(&options, B300);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetispeed", NULL);
+            if ((ret == -1) || (lsr & TIOCSER_TEMT)) {
+                break;
+            }
 
-            return UART_ESYSAPI;
+            bytes = 1;
         }
-        
-        ret = cfsetospeed(&options, B300);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetospeed", NULL);
-
-            return UART_ESYSAPI;
+#else
+        if (bytes == 0) {
+            break;
         }
-        
-        break;
-    case UART_BAUD_600:
-        ret = cfsetispeed(&options, B600);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetispeed", NULL);
+#endif
 
-            return UART_ESYSAPI;
+        /* 10 bits per character (start, 8 data, stop) */
+        if ((int) uart->baud > 0) {
+            wait = ((long long) bytes * 10 * 1000000) / (int) uart->baud;
+        } else {
+            wait = 1000;
         }
-        
-        ret = cfsetospeed(&options, B600);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetospeed", NULL);
 
-            return UART_ESYSAPI;
+        if (wait < 100) {
+            wait = 100;
         }
-        
-        break;
-    case UART_BAUD_1200:
-        ret = cfsetispeed(&options, B1200);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetispeed", NULL);
 
-            return UART_ESYSAPI;
-        }
-        
-        ret = cfsetospeed(&options, B1200);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetospeed", NULL);
+        if (timeout >= 0) {
+            if (time_get_ms() >= deadline) {
+                _uart_error(ctx, uart, UART_ETIMEOUT, NULL, "output queue not empty");
 
-            return UART_ESYSAPI;
-        }
-        
-        break;
-    case UART_BAUD_1800:
-        ret = cfsetispeed(&options, B1800);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetispeed", NULL);
+                return UART_ETIMEOUT;
+            }
 
-            return UART_ESYSAPI;
+            if (wait > ((deadline - time_get_ms()) * 1000)) {
+                wait = (deadline - time_get_ms()) * 1000;
+            }
         }
-        
-        ret = cfsetospeed(&options, B1800);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetospeed", NULL);
 
-            return UART_ESYSAPI;
+        if (wait > 0) {
+            usleep((useconds_t) wait);
         }
+    }
 
-        break;
-    case UART_BAUD_2400:
-        ret = cfsetispeed(&options, B2400);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetispeed", NULL);
+    return UART_ESUCCESS;
+}
 
-            return UART_ESYSAPI;
-        }
-        
-        ret = cfsetospeed(&options, B2400);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetospeed", NULL);
+int _uart_get_queue(struct _uart_ctx *ctx, struct _uart *uart, int *in, int *out)
+{
+    int ret;
 
-            return UART_ESYSAPI;
-        }
-        
-        break;
-    case UART_BAUD_4800:
-        ret = cfsetispeed(&options, B4800);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetispeed", NULL);
+    if (!ctx) {
+        return UART_ECTX;
+    }
 
-            return UART_ESYSAPI;
-        }
-        
-        ret = cfsetospeed(&options, B4800);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetospeed", NULL);
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
 
-            return UART_ESYSAPI;
-        }
-        
-        break;
-    case UART_BAUD_9600:
-        ret = cfsetispeed(&options, B9600);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetispeed", NULL);
+        return UART_EHANDLE;
+    }
 
-            return UART_ESYSAPI;
-        }
-        
-        ret = cfsetospeed(&options, B9600);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetospeed", NULL);
+    ret = ioctl(uart->fd, FIONREAD, in);
 
-            return UART_ESYSAPI;
-        }
-        
-        break;
-    case UART_BAUD_19200:
-        ret = cfsetispeed(&options, B19200);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetispeed", NULL);
+    if (ret == -1) {
+        _uart_error(ctx, uart, UART_ESYSAPI, "ioctl", "FIONREAD");
 
-            return UART_ESYSAPI;
-        }
-        
-        ret = cfsetospeed(&options, B19200);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetospeed", NULL);
+        return UART_ESYSAPI;
+    }
 
-            return UART_ESYSAPI;
-        }
-        
-        break;
-    case UART_BAUD_38400:
-        ret = cfsetispeed(&options, B38400);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetispeed", NULL);
+    ret = ioctl(uart->fd, TIOCOUTQ, out);
 
-            return UART_ESYSAPI;
-        }
-        
-        ret = cfsetospeed(&options, B38400);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetospeed", NULL);
+    if (ret == -1) {
+        _uart_error(ctx, uart, UART_ESYSAPI, "ioctl", "TIOCOUTQ");
 
-            return UART_ESYSAPI;
-        }
-        
-        break;
-    case UART_BAUD_57600:
-        ret = cfsetispeed(&options, B57600);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetispeed", NULL);
+        return UART_ESYSAPI;
+    }
 
-            return UART_ESYSAPI;
-        }
-        
-        ret = cfsetospeed(&options, B57600);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetospeed", NULL);
+    return UART_ESUCCESS;
+}
 
-            return UART_ESYSAPI;
-        }
-        
-        break;
-    case UART_BAUD_115200:
-        ret = cfsetispeed(&options, B115200);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetispeed", NULL);
+int _uart_get_counters(struct _uart_ctx *ctx, struct _uart *uart, struct uart_counters *counters)
+{
+#ifdef __linux__
+    int ret;
+#endif
 
-            return UART_ESYSAPI;
-        }
-        
-        ret = cfsetospeed(&options, B115200);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetospeed", NULL);
+    if (!ctx) {
+        return UART_ECTX;
+    }
 
-            return UART_ESYSAPI;
-        }
-        
-        break;
-    case UART_BAUD_230400:
-        ret = cfsetispeed(&options, B230400);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetispeed", NULL);
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
 
-            return UART_ESYSAPI;
-        }
-        
-        ret = cfsetospeed(&options, B230400);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetospeed", NULL);
+        return UART_EHANDLE;
+    }
 
-            return UART_ESYSAPI;
-        }
+#ifdef __linux__
+    ret = read_icount(uart->fd, counters);
 
-        break;
-    case UART_BAUD_460800:
-        ret = cfsetispeed(&options, B460800);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetispeed", NULL);
+    if (ret == -1) {
+        _uart_error(ctx, uart, UART_ESYSAPI, "ioctl", "TIOCGICOUNT");
 
-            return UART_ESYSAPI;
-        }
-        
-        ret = cfsetospeed(&options, B460800);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetospeed", NULL);
+        return UART_ESYSAPI;
+    }
 
-            return UART_ESYSAPI;
-        }
+    return UART_ESUCCESS;
+#else
+    (void) counters;
+    _uart_error(ctx, uart, UART_ENOTSUP, NULL, "TIOCGICOUNT");
 
-        break;
-    case UART_BAUD_500000:
-        ret = cfsetispeed(&options, B500000);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetispeed", NULL);
+    return UART_ENOTSUP;
+#endif
+}
 
-            return UART_ESYSAPI;
-        }
-        
-        ret = cfsetospeed(&options, B500000);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetospeed", NULL);
+int _uart_set_multidrop(struct _uart_ctx *ctx, struct _uart *uart, int address)
+{
+    int ret;
+    struct termios options;
+    enum e_data data_bits;
+    enum e_parity parity;
 
-            return UART_ESYSAPI;
-        }
+    if (!ctx) {
+        return UART_ECTX;
+    }
 
-        break;
-#ifdef __linux__
-    case UART_BAUD_576000:
-        ret = cfsetispeed(&options, B576000);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetispeed", NULL);
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
 
-            return UART_ESYSAPI;
-        }
-        
-        ret = cfsetospeed(&options, B576000);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetospeed", NULL);
+        return UART_EHANDLE;
+    }
 
-            return UART_ESYSAPI;
-        }
+    if (address > 0xFF) {
+        _uart_error(ctx, uart, UART_EINVAL, NULL, "multidrop address");
 
-        break;
-#endif
-    case UART_BAUD_921600:
-        ret = cfsetispeed(&options, B921600);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetispeed", NULL);
+        return UART_EINVAL;
+    }
 
-            return UART_ESYSAPI;;
-        }
-        
-        ret = cfsetospeed(&options, B921600);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetospeed", NULL);
+    data_bits = uart->data_bits;
+    parity = uart->parity;
+    options = uart->tio;
 
-            return UART_ESYSAPI;
+    /**
+     * Data bytes are sent and expected with space parity, so an address
+     * byte (9th bit set) is received as parity error and marked by the
+     * kernel with 0xFF 0x00 (PARMRK).
+     */
+    if (address >= 0) {
+        /* keep the user settings for disabling (not on an address change) */
+        if (uart->md_addr < 0) {
+            uart->md_data_bits = data_bits;
+            uart->md_parity = parity;
+            uart->md_iflag = options.c_iflag & (INPCK | PARMRK | IGNPAR | ISTRIP);
         }
 
-        break;
-    case UART_BAUD_1000000:
-        ret = cfsetispeed(&options, B1000000);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetispeed", NULL);
+        uart->data_bits = UART_DATA_8;
+        uart->parity = UART_PARITY_SPACE;
+        options.c_iflag |= (INPCK | PARMRK);
+        options.c_iflag &= ~(IGNPAR | ISTRIP);
+    } else if (uart->md_addr >= 0) {
+        uart->data_bits = uart->md_data_bits;
+        uart->parity = uart->md_parity;
+        options.c_iflag &= ~(INPCK | PARMRK | IGNPAR | ISTRIP);
+        options.c_iflag |= uart->md_iflag;
 
-            return UART_ESYSAPI;
+        /* still needed for the receive error records */
+        if (uart->rx_errors) {
+            options.c_iflag |= (INPCK | PARMRK);
         }
-        
-        ret = cfsetospeed(&options, B1000000);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetospeed", NULL);
+    } else {
+        return UART_ESUCCESS;
+    }
 
-            return UART_ESYSAPI;
-        }
+    ret = termios_databits(ctx, uart, &options);
 
-        break;
-#ifdef __linux__
-    case UART_BAUD_1152000:
-        ret = cfsetispeed(&options, B1152000);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetispeed", NULL);
+    if (ret == UART_ESUCCESS) {
+        ret = termios_parity(ctx, uart, &options);
+    }
 
-            return UART_ESYSAPI;
-        }
-        
-        ret = cfsetospeed(&options, B1152000);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetospeed", NULL);
+    if (ret == UART_ESUCCESS) {
+        ret = termios_apply(ctx, uart, &options, 1);
+    }
 
-            return UART_ESYSAPI;
-        }
+    if (ret != UART_ESUCCESS) {
+        uart->data_bits = data_bits;
+        uart->parity = parity;
 
-        break;
-#endif
-    case UART_BAUD_1500000:
-        ret = cfsetispeed(&options, B1500000);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetispeed", NULL);
+        return ret;
+    }
 
-            return UART_ESYSAPI;
-        }
-        
-        ret = cfsetospeed(&options, B1500000);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetospeed", NULL);
+    uart->md_addr = address;
+    uart->md_selected = 0;
+    uart->rx_esc = 0;
 
-            return UART_ESYSAPI;
-        }
+    return UART_ESUCCESS;
+}
 
-        break;
-    case UART_BAUD_2000000:
-        ret = cfsetispeed(&options, B2000000);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetispeed", NULL);
+int _uart_send_address(struct _uart_ctx *ctx, struct _uart *uart, unsigned char address)
+{
+    int ret;
+    ssize_t num;
+    struct termios options;
+    struct pollfd pfd;
+    long long deadline;
+    long long wait;
 
-            return UART_ESYSAPI;
-        }
-        
-        ret = cfsetospeed(&options, B2000000);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetospeed", NULL);
+    if (!ctx) {
+        return UART_ECTX;
+    }
 
-            return UART_ESYSAPI;
-        }
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
 
-        break;
-    case UART_BAUD_2500000:
-        ret = cfsetispeed(&options, B2500000);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetispeed", NULL);
+        return UART_EHANDLE;
+    }
 
-            return UART_ESYSAPI;
-        }
-        
-        ret = cfsetospeed(&options, B2500000);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetospeed", NULL);
+    if (uart->md_addr < 0) {
+        _uart_error(ctx, uart, UART_EINVAL, NULL, "multidrop mode not enabled");
 
-            return UART_ESYSAPI;
-        }
+        return UART_EINVAL;
+    }
 
-        break;
-    case UART_BAUD_3000000:
-        ret = cfsetispeed(&options, B3000000);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetispeed", NULL);
+    /**
+     * The parity changes only after all previous data was sent. Flow
+     * control can stop the output forever, so TCSADRAIN isn't used.
+     */
+    deadline = time_get_ms() + UART_ADDRTIMEOUT;
+    ret = _uart_drain(ctx, uart, UART_ADDRTIMEOUT);
 
-            return UART_ESYSAPI;
-        }
-        
-        ret = cfsetospeed(&options, B3000000);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetospeed", NULL);
+    if (ret != UART_ESUCCESS) {
+        return ret;
+    }
 
-            return UART_ESYSAPI;
-        }
+    /* the address is sent with the driver enabled like any other data */
+    _uart_rs485_begin(ctx, uart);
 
-        break;
-    case UART_BAUD_3500000:
-        ret = cfsetispeed(&options, B3500000);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetispeed", NULL);
+    options = uart->tio;
+    uart->parity = UART_PARITY_MARK;
+    termios_parity(ctx, uart, &options);
+    ret = termios_apply(ctx, uart, &options, 0);
 
-            return UART_ESYSAPI;
-        }
-        
-        ret = cfsetospeed(&options, B3500000);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetospeed", NULL);
+    if (ret != UART_ESUCCESS) {
+        uart->parity = UART_PARITY_SPACE;
+        _uart_rs485_end(ctx, uart);
 
-            return UART_ESYSAPI;
-        }
+        return ret;
+    }
 
-        break;
-    case UART_BAUD_4000000:
-        ret = cfsetispeed(&options, B4000000);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetispeed", NULL);
+    pfd.fd = uart->fd;
+    pfd.events = POLLOUT;
 
-            return UART_ESYSAPI;
+    do {
+        num = write(uart->fd, &address, 1);
+
+        if ((num == -1) && (errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR)) {
+            _uart_error(ctx, uart, UART_ESYSAPI, "write", NULL);
+            ret = UART_ESYSAPI;
+
+            break;
         }
-        
-        ret = cfsetospeed(&options, B4000000);
-        
-        if (ret == -1) {
-            _uart_error(ctx, uart, UART_ESYSAPI, "cfsetospeed", NULL);
 
-            return UART_ESYSAPI;
+        if (num != 1) {
+            wait = deadline - time_get_ms();
+
+            if (wait <= 0) {
+                _uart_error(ctx, uart, UART_ETIMEOUT, NULL, "could not send address");
+                ret = UART_ETIMEOUT;
+
+                break;
+            }
+
+            poll(&pfd, 1, (int) wait);
         }
+    } while (num != 1);
 
-        break;
-    default:
-        _uart_error(ctx, uart, UART_EBAUD, NULL, NULL);
+    if (ret == UART_ESUCCESS) {
+        wait = deadline - time_get_ms();
+        ret = _uart_drain(ctx, uart, (wait > 0) ? (int) wait : 0);
+    }
 
-        return UART_EBAUD;
+    /* an address byte left in the queue would be sent with space parity */
+    if (ret != UART_ESUCCESS) {
+        tcflush(uart->fd, TCOFLUSH);
     }
-    
-    ret = tcsetattr(uart->fd, TCSANOW, &options);
-    
-    if (ret == -1) {
-        _uart_error(ctx, uart, UART_ESYSAPI, "tcsetattr", NULL);
 
-        return UART_ESYSAPI;
+    _uart_rs485_end(ctx, uart);
+
+    options = uart->tio;
+    uart->parity = UART_PARITY_SPACE;
+    termios_parity(ctx, uart, &options);
+
+    if (ret != UART_ESUCCESS) {
+        termios_apply(ctx, uart, &options, 0);
+
+        return ret;
     }
-    
-    return UART_ESUCCESS;
+
+    return termios_apply(ctx, uart, &options, 0);
 }
 
-int _uart_init_databits(struct _uart_ctx *ctx, struct _uart *uart)
+int _uart_set_rx_errors(struct _uart_ctx *ctx, struct _uart *uart, int mask)
 {
     int ret;
     struct termios options;
-    
+
     if (!ctx) {
         return UART_ECTX;
     }
@@ -699,53 +2421,63 @@ int _uart_init_databits(struct _uart_ctx *ctx, struct _uart *uart)
         return UART_EHANDLE;
     }
 
-    ret = tcgetattr(uart->fd, &options);
-    
-    if (ret == -1) {
-        _uart_error(ctx, uart, UART_ESYSAPI, "tcgetattr", NULL);
+    mask &= (UART_RXERR_CHAR | UART_RXERR_BREAK);
 
-        return UART_ESYSAPI;
+    if (mask && !uart->rx_err) {
+        uart->rx_err = (struct uart_rx_error *) malloc(UART_RXERRMAX * sizeof(struct uart_rx_error));
+
+        if (!uart->rx_err) {
+            _uart_error(ctx, uart, UART_EBUF, NULL, "error records");
+
+            return UART_EBUF;
+        }
     }
-    
-    switch (uart->data_bits) {
-    case UART_DATA_5:
-        options.c_cflag &= ~CSIZE;
-        options.c_cflag |= CS5;
-        break;
-    case UART_DATA_6:
-        options.c_cflag &= ~CSIZE;
-        options.c_cflag |= CS6;
-        break;
-    case UART_DATA_7:
-        options.c_cflag &= ~CSIZE;
-        options.c_cflag |= CS7;
-        break;
-    case UART_DATA_8:
-        options.c_cflag &= ~CSIZE;
-        options.c_cflag |= CS8;
-        break;
-    default:
-        _uart_error(ctx, uart, UART_EDATA, NULL, "unsupported");
 
-        return UART_EDATA;
+    /**
+     * With PARMRK the kernel marks a character with a parity or framing
+     * error as 0xFF 0x00 <char>, a break as 0xFF 0x00 0x00 and a 0xFF
+     * data byte as 0xFF 0xFF.
+     */
+    options = uart->tio;
+
+    if (mask) {
+        options.c_iflag |= PARMRK;
+        options.c_iflag &= ~(IGNPAR | ISTRIP | IGNBRK | BRKINT);
     }
-    
-    ret = tcsetattr(uart->fd, TCSANOW, &options);
-    
-    if (ret == -1) {
-        _uart_error(ctx, uart, UART_ESYSAPI, "tcsetattr", NULL);
 
-        return UART_ESYSAPI;
+    /* parity is only checked if character errors are requested */
+    if (mask & UART_RXERR_CHAR) {
+        options.c_iflag |= INPCK;
+    } else if (uart->md_addr < 0) {
+        options.c_iflag &= ~INPCK;
     }
-    
+
+    if (!mask && (uart->md_addr < 0)) {
+        options.c_iflag &= ~PARMRK;
+    }
+
+    ret = termios_apply(ctx, uart, &options, 0);
+
+    if (ret != UART_ESUCCESS) {
+        return ret;
+    }
+
+    uart->rx_errors = mask;
+    uart->rx_err_head = 0;
+    uart->rx_err_num = 0;
+    uart->rx_err_lost = 0;
+
+    if (uart->md_addr < 0) {
+        uart->rx_esc = 0;
+    }
+
     return UART_ESUCCESS;
 }
 
-int _uart_init_parity(struct _uart_ctx *ctx, struct _uart *uart)
+int _uart_send_break(struct _uart_ctx *ctx, struct _uart *uart, int duration)
 {
     int ret;
-    struct termios options;
-    
+
     if (!ctx) {
         return UART_ECTX;
     }
@@ -756,421 +2488,427 @@ int _uart_init_parity(struct _uart_ctx *ctx, struct _uart *uart)
         return UART_EHANDLE;
     }
 
-    ret = tcgetattr(uart->fd, &options);
-    
+    /* the break must not cut off data still in the transmitter */
+    ret = _uart_drain(ctx, uart, -1);
+
+    if (ret != UART_ESUCCESS) {
+        return ret;
+    }
+
+    if (duration <= 0) {
+        ret = tcsendbreak(uart->fd, 0);
+
+        if (ret == -1) {
+            _uart_error(ctx, uart, UART_ESYSAPI, "tcsendbreak", NULL);
+
+            return UART_ESYSAPI;
+        }
+
+        return UART_ESUCCESS;
+    }
+
+    ret = ioctl(uart->fd, TIOCSBRK);
+
     if (ret == -1) {
-        _uart_error(ctx, uart, UART_ESYSAPI, "tcgetattr", NULL);
+        _uart_error(ctx, uart, UART_ESYSAPI, "ioctl", "TIOCSBRK");
 
         return UART_ESYSAPI;
     }
-    
-    switch (uart->parity) {
-    case UART_PARITY_NONE:
-        options.c_cflag &= ~PARENB;
-        break;
-    case UART_PARITY_ODD:
-        options.c_cflag |= PARENB;
-        options.c_cflag |= PARODD;
-        break;
-    case UART_PARITY_EVEN:
-        options.c_cflag |= PARENB;
-        options.c_cflag &= ~PARODD;
-        break;
-    default:
-        _uart_error(ctx, uart, UART_EPARITY, NULL, "unsupported");
 
-        return UART_EPARITY;
-    }
-    
-    ret = tcsetattr(uart->fd, TCSANOW, &options);
-    
+    usleep((useconds_t) duration * 1000);
+    ret = ioctl(uart->fd, TIOCCBRK);
+
     if (ret == -1) {
-        _uart_error(ctx, uart, UART_ESYSAPI, "tcsetattr", NULL);
+        _uart_error(ctx, uart, UART_ESYSAPI, "ioctl", "TIOCCBRK");
 
         return UART_ESYSAPI;
     }
-    
+
     return UART_ESUCCESS;
 }
 
-int _uart_init_stopbits(struct _uart_ctx *ctx, struct _uart *uart)
+int _uart_get_rx_errors(struct _uart *uart, struct uart_rx_error *errors, int max, unsigned long *lost)
 {
-    int ret;
-    struct termios options;
-    
-    if (!ctx) {
-        return UART_ECTX;
-    }
+    int num = 0;
 
-    if (!uart) {
-        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+    while ((num < max) && (uart->rx_err_num > 0)) {
+        errors[num++] = uart->rx_err[uart->rx_err_head];
+        uart->rx_err_head = (uart->rx_err_head + 1) % UART_RXERRMAX;
+        uart->rx_err_num--;
+    }
 
-        return UART_EHANDLE;
+    if (lost) {
+        *(lost) = uart->rx_err_lost;
+        uart->rx_err_lost = 0;
     }
 
-    ret = tcgetattr(uart->fd, &options);
-    
-    if (ret == -1) {
-        _uart_error(ctx, uart, UART_ESYSAPI, "tcgetattr", NULL);
+    return num;
+}
 
-        return UART_ESYSAPI;
-    }
-    
-    switch (uart->stop_bits) {
-    case UART_STOP_1_0:
-        options.c_cflag &= ~CSTOPB;
-        break;
-    case UART_STOP_2_0:
-        options.c_cflag |= CSTOPB;
-        break;
-    default:
-        _uart_error(ctx, uart, UART_ESTOP, NULL, "unsupported");
+static void rx_error_add(struct _uart *uart, unsigned long long offset, int kind, unsigned char data)
+{
+    struct uart_rx_error *err;
 
-        return UART_ESTOP;
+    if (!(uart->rx_errors & kind)) {
+        return;
     }
-    
-    ret = tcsetattr(uart->fd, TCSANOW, &options);
-    
-    if (ret == -1) {
-        _uart_error(ctx, uart, UART_ESYSAPI, "tcsetattr", NULL);
 
-        return UART_ESYSAPI;
+    /* the oldest records are dropped if nobody collects them */
+    if (uart->rx_err_num == UART_RXERRMAX) {
+        uart->rx_err_head = (uart->rx_err_head + 1) % UART_RXERRMAX;
+        uart->rx_err_num--;
+        uart->rx_err_lost++;
     }
-    
-    return UART_ESUCCESS;
+
+    err = &uart->rx_err[(uart->rx_err_head + uart->rx_err_num) % UART_RXERRMAX];
+    err->offset = offset;
+    err->kind = kind;
+    err->data = data;
+    uart->rx_err_num++;
 }
 
-int _uart_init_flow(struct _uart_ctx *ctx, struct _uart *uart)
+ssize_t _uart_parmrk_filter(struct _uart *uart, unsigned char *data, ssize_t len)
 {
-    int ret;
-    struct termios options;
-    
-    if (!ctx) {
-        return UART_ECTX;
-    }
+    ssize_t i = 0;
+    ssize_t o = 0;
+    ssize_t n;
+    unsigned char *p;
+    int deliver;
+
+    while (i < len) {
+        deliver = (uart->md_addr < 0) || uart->md_selected;
+
+        switch (uart->rx_esc) {
+        case 0:
+            /* copy plain data up to the next PARMRK escape in one block */
+            p = (unsigned char *) memchr(data + i, 0xFF, (size_t) (len - i));
+            n = (p) ? (p - (data + i)) : (len - i);
+
+            if (deliver && n) {
+                memmove(data + o, data + i, (size_t) n);
+                o += n;
+            }
 
-    if (!uart) {
-        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+            i += n;
 
-        return UART_EHANDLE;
-    }
+            if (p) {
+                uart->rx_esc = 1;
+                i++;
+            }
 
-    ret = tcgetattr(uart->fd, &options);
-    
-    if (ret == -1) {
-        _uart_error(ctx, uart, UART_ESYSAPI, "tcgetattr", NULL);
+            break;
+        case 1:
+            if (data[i] == 0x00) {
+                uart->rx_esc = 2;
+            } else {
+                /* 0xFF 0xFF is an escaped data byte 0xFF */
+                if (deliver) {
+                    data[o++] = data[i];
+                }
 
-        return UART_ESYSAPI;
-    }
-    
-    switch (uart->flow_ctrl) {
-    case UART_FLOW_NO:
-        options.c_iflag &= ~(IXON | IXOFF | IXANY);
-        break;
-    case UART_FLOW_SW:
-        options.c_iflag |= (IXON | IXOFF | IXANY);
-        break;
-    case UART_FLOW_HW:
-        options.c_iflag &= ~(IXON | IXOFF | IXANY);
-        break;
-    default:
-        _uart_error(ctx, uart, UART_EFLOW, NULL, "unsupported");
+                uart->rx_esc = 0;
+            }
 
-        return UART_EFLOW;
+            i++;
+            break;
+        default:
+            /* 0xFF 0x00 <char>, in multidrop mode <char> is an address */
+            if (uart->md_addr >= 0) {
+                uart->md_selected = (data[i] == (unsigned char) uart->md_addr);
+            } else if (data[i] == 0x00) {
+                rx_error_add(uart, uart->rx_offset + (unsigned long long) o, UART_RXERR_BREAK, 0);
+            } else {
+                rx_error_add(uart, uart->rx_offset + (unsigned long long) o, UART_RXERR_CHAR, data[i]);
+                data[o++] = data[i];
+            }
+
+            uart->rx_esc = 0;
+            i++;
+            break;
+        }
     }
-    
-    ret = tcsetattr(uart->fd, TCSANOW, &options);
-    
-    if (ret == -1) {
-        _uart_error(ctx, uart, UART_ESYSAPI, "tcsetattr", NULL);
 
-        return UART_ESYSAPI;
+    return o;
+}
+
+void _uart_rx_error_skip(struct _uart *uart, ssize_t skip)
+{
+    struct uart_rx_error *err;
+    unsigned long long pos;
+    int i;
+
+    /**
+     * Only the records of the last decoded block are at or behind
+     * rx_offset, errors within the dropped bytes move to the first
+     * delivered byte.
+     */
+    for (i = 0; i < uart->rx_err_num; i++) {
+        err = &uart->rx_err[(uart->rx_err_head + i) % UART_RXERRMAX];
+
+        if (err->offset < uart->rx_offset) {
+            continue;
+        }
+
+        pos = err->offset - uart->rx_offset;
+        err->offset -= (pos < (unsigned long long) skip) ? pos : (unsigned long long) skip;
     }
-    
-    return UART_ESUCCESS;
 }
 
-int _uart_init(struct _uart_ctx *ctx)
+int _uart_flow_update(struct _uart_ctx *ctx, struct _uart *uart, int pending)
 {
     int ret;
-    int i;
-    gid_t g_list[256];
-    struct group *g;
+    int status;
+    int queued;
+    long long now;
 
     if (!ctx) {
         return UART_ECTX;
     }
 
-    ret = getgroups(256, g_list);
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
 
-    if (ret == -1) {
-        _uart_error(ctx, NULL, UART_ESYSAPI, "getgroups", NULL);
+        return UART_EHANDLE;
+    }
 
-        return UART_ESYSAPI;
+    if (uart->flow_ctrl != UART_FLOW_HW) {
+        return UART_ESUCCESS;
     }
 
-#ifdef __linux__
-    /**
-     * User must be in group 'dialout' for using the UART on Linux
-     */
-    g = getgrnam("dialout");
-#elif __FreeBSD__
-    /**
-     * User must be in group 'dialer' for using the UART on FreeBSD
-     */
-    g = getgrnam("dialer");
-#else
-#error "Unsupported POSIX compatible operating system."
-#endif
+    /* data still waiting in the kernel is stopped by CTS as well */
+    if (!pending) {
+        ret = ioctl(uart->fd, TIOCOUTQ, &queued);
+        pending = ((ret == 0) && (queued > 0));
+    }
 
-    if (!g) {
-        _uart_error(ctx, NULL, UART_ESYSAPI, "getgrnam", NULL);
+    /* the TX worker samples again only while this is set */
+    uart->flow_pending = pending;
 
-        return UART_ESYSAPI;
+    if (!pending && !uart->flow.blocked) {
+        return UART_ESUCCESS;
     }
 
-    for (i = 0; i < ret; i++) {
-        if (g_list[i] == g->gr_gid) {
-            ctx->flags |= UART_CTXFOKAY;
-            return UART_ESUCCESS;;
-        }
-    }
+    ret = ioctl(uart->fd, TIOCMGET, &status);
 
-    return UART_EPERM;
-}
+    if (ret == -1) {
+        _uart_error(ctx, uart, UART_ESYSAPI, "ioctl", "TIOCMGET");
 
-int _uart_get_device_list(struct _uart_ctx *ctx)
-{
-#ifdef __linux__
-    FILE *f;
-    char line[512];
-    char devname[128];
-    char devtype[128];
-    char *line_ptr;
-    char *ptr;
-    char *cell_ptr;
-    int count;
-    DIR *dir;
-    struct dirent *entry;
-    char *dev[512];
-    int dev_index = 0;
-    int i;
-#elif __FreeBSD__
-    DIR *dir;
-    struct dirent *entry;
-#else
-#error "Unsupported POSIX compatible operating system."
-#endif
+        return UART_ESYSAPI;
+    }
 
-    if (!ctx) {
-        return UART_ECTX;
+    now = time_get_ms();
+
+    if (pending && !(status & TIOCM_CTS) && !uart->flow.blocked) {
+        uart->flow.blocked = 1;
+        uart->flow.stalls++;
+        uart->flow_since = now;
+    } else if (uart->flow.blocked && (!pending || (status & TIOCM_CTS))) {
+        uart->flow.blocked = 0;
+        uart->flow.blocked_ms += now - uart->flow_since;
     }
 
-#ifdef __linux__
-    line_ptr = (char *) line;
+    return UART_ESUCCESS;
+}
 
-    f = fopen("/proc/tty/drivers", "rb");
+#ifdef __linux__
+/**
+ * Write a decimal value to a sysfs attribute of the tty
+ *
+ * Returns 0 on success, 1 if the attribute doesn't exist and -1 on error.
+ */
+static int sysfs_write_int(const char *dir, const char *name, const char *attr, int value)
+{
+    char path[UART_NAMEMAX];
+    char buf[16];
+    int fd;
+    int len;
+    ssize_t ret;
 
-    if (!f) {
-        _uart_error(ctx, NULL, UART_ESYSAPI, "fopen", NULL);
+    snprintf(path, sizeof(path), "%s/%s/%s", dir, name, attr);
+    fd = open(path, O_WRONLY);
 
-        return UART_ESYSAPI;
+    if (fd == -1) {
+        return (errno == ENOENT) ? 1 : -1;
     }
 
-    /**
-     * Parse file '/proc/tty/drivers' for available UART's
-     */
-    while (!feof(f)) {
-        fread(line_ptr, 1, 1, f);
+    len = snprintf(buf, sizeof(buf), "%d", value);
+    ret = write(fd, buf, (size_t) len);
+    close(fd);
 
-        if (*line_ptr == '\n') {
-            *line_ptr = '\0';
-            ptr = (char *) line;
-            cell_ptr = (char *) line;
+    return (ret == len) ? 0 : -1;
+}
+#endif
 
-            while (*ptr != ' ') {
-                ptr++;
-            }
+int _uart_set_latency(struct _uart_ctx *ctx, struct _uart *uart, const struct uart_latency *lat)
+{
+#ifdef __linux__
+    int ret;
+    struct serial_struct serial;
+    char path[PATH_MAX];
+    const char *name;
+    const char *unsupported = NULL;
+#endif
 
-            while (*ptr == ' ') {
-                ptr++;
-            }
+    if (!ctx) {
+        return UART_ECTX;
+    }
 
-            cell_ptr = ptr;
-            count = 0;
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
 
-            while (*ptr != ' ') {
-                count++;
-                ptr++;
-            }
+        return UART_EHANDLE;
+    }
 
-            memset(devname, 0, 128);
-            strncpy(devname, cell_ptr, count);
+#ifdef __linux__
+    if (lat->low_latency != UART_LATENCY_KEEP) {
+        ret = ioctl(uart->fd, TIOCGSERIAL, &serial);
 
-            while (*ptr == ' ') {
-                ptr++;
-            }
+        if (ret == 0) {
+            if (lat->low_latency)
+                serial.flags |= ASYNC_LOW_LATENCY;
+            else
+                serial.flags &= ~ASYNC_LOW_LATENCY;
 
-            while (*ptr != ' ') {
-                ptr++;
-            }
+            ret = ioctl(uart->fd, TIOCSSERIAL, &serial);
+        }
 
-            while (*ptr == ' ') {
-                ptr++;
-            }
+        if (ret == -1) {
+            if ((errno != ENOTTY) && (errno != EINVAL)) {
+                _uart_error(ctx, uart, UART_ESYSAPI, "ioctl", "TIOCSSERIAL");
 
-            while (*ptr != ' ') {
-                ptr++;
+                return UART_ESYSAPI;
             }
 
-            while (*ptr == ' ') {
-                ptr++;
-            }
+            unsupported = "low latency";
+        }
+    }
 
-            cell_ptr = ptr;
-            count = 0;
+    /* sysfs uses the kernel name of the tty (device may be a symlink) */
+    if (!realpath(uart->dev, path)) {
+        strncpy(path, uart->dev, sizeof(path) - 1);
+        path[sizeof(path) - 1] = '\0';
+    }
 
-            while (*ptr != '\0') {
-                count++;
-                ptr++;
-            }
+    name = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
 
-            memset(devtype, 0, 128);
-            strncpy(devtype, cell_ptr, count);
+    if (lat->rx_trigger != UART_LATENCY_KEEP) {
+        ret = sysfs_write_int("/sys/class/tty", name, "rx_trig_bytes", lat->rx_trigger);
 
-            /**
-             * Test if device is an UART (serial)
-             */
-            if (strcmp(devtype, "serial") == 0) {
-                dev[dev_index] = malloc(strlen(strrchr(devname, '/') + 1) + 1);
-                strcpy(dev[dev_index], strrchr(devname, '/') + 1);
-                dev_index++;
-            }
+        if (ret == -1) {
+            _uart_error(ctx, uart, UART_ESYSAPI, "write", "rx_trig_bytes");
 
-            line_ptr = (char *) line;
-        } else {
-            line_ptr++;
+            return UART_ESYSAPI;
         }
 
-
+        if (ret == 1) {
+            unsupported = "rx_trig_bytes";
+        }
     }
 
-    fclose(f);
-
-    if (dev_index == 0) {
-        _uart_error(ctx, NULL, UART_EDEV, NULL, "no UART devices found");
+    if (lat->latency_timer != UART_LATENCY_KEEP) {
+        ret = sysfs_write_int("/sys/bus/usb-serial/devices", name, "latency_timer", lat->latency_timer);
 
-        return UART_EDEV;
-    }
+        if (ret == -1) {
+            _uart_error(ctx, uart, UART_ESYSAPI, "write", "latency_timer");
 
-    /**
-     * Parse directory '/sys/class/tty' for available UART's
-     */
-    dir = opendir("/sys/class/tty");
+            return UART_ESYSAPI;
+        }
 
-    if (!dir) {
-        for (i = 0; i < dev_index; i++) {
-            free(dev[i]);
+        if (ret == 1) {
+            unsupported = "latency_timer";
         }
+    }
 
-        _uart_error(ctx, NULL, UART_ESYSAPI, "opendir", NULL);
+    if (unsupported) {
+        _uart_error(ctx, uart, UART_ENOTSUP, NULL, unsupported);
 
-        return UART_ESYSAPI;
+        return UART_ENOTSUP;
     }
 
-    entry = readdir(dir);
-
-    while (entry) {
-        for (i = 0; i < dev_index; i++) {
-            if (strncmp(entry->d_name, dev[i], strlen(dev[i])) == 0) {
-                ctx->uarts[ctx->uarts_count] = (struct _uart *) malloc(sizeof(struct _uart));
+    return UART_ESUCCESS;
+#else
+    (void) lat;
+    _uart_error(ctx, uart, UART_ENOTSUP, NULL, "latency profile");
 
-                if (!ctx->uarts[ctx->uarts_count]) {
-                    _uart_error(ctx, NULL, UART_ENOMEM, NULL, NULL);
+    return UART_ENOTSUP;
+#endif
+}
 
-                    return UART_ENOMEM;
-                }
+int _uart_set_pins(struct _uart_ctx *ctx, struct _uart *uart, int set, int clear)
+{
+    int ret;
+    int bits;
+    int outputs = UART_PIN_MASK(UART_PIN_RTS) | UART_PIN_MASK(UART_PIN_DTR);
 
-                ctx->uarts[ctx->uarts_count]->errormsg = (char *) malloc(UART_ERRORMAX);
+    if (!ctx) {
+        return UART_ECTX;
+    }
 
-                if (!ctx->uarts[ctx->uarts_count]->errormsg) {
-                    _uart_error(ctx, NULL, UART_ENOMEM, NULL, NULL);
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
 
-                    return UART_ENOMEM;
-                }
+        return UART_EHANDLE;
+    }
 
-                memset(ctx->uarts[ctx->uarts_count], 0, sizeof(struct _uart));
-                snprintf(ctx->uarts[ctx->uarts_count]->dev, UART_NAMEMAX, "/dev/%s", entry->d_name);
-                ctx->uarts_count++;
-            }
-        }
+    if ((set | clear) & ~outputs) {
+        _uart_error(ctx, uart, UART_EPIN, NULL, "not an output pin");
 
-        entry = readdir(dir);
+        return UART_EPIN;
     }
 
-    closedir(dir);
+    if (set & clear) {
+        _uart_error(ctx, uart, UART_EPIN, NULL, "pin set and cleared");
 
-    for (i = 0; i < dev_index; i++) {
-        free(dev[i]);
+        return UART_EPIN;
     }
 
-#elif __FreeBSD__
-    /**
-     * Parse directory '/dev' for available UART's
-     */
-    dir = opendir("/dev");
+    /* TIOCMBIS/TIOCMBIC change only the given lines in one ioctl each */
+    if (set) {
+        bits = 0;
 
-    if (!dir) {
-        _uart_error(ctx, NULL, UART_ESYSAPI, "opendir", NULL);
+        if (set & UART_PIN_MASK(UART_PIN_RTS))
+            bits |= TIOCM_RTS;
 
-        return UART_ESYSAPI;
-    }
+        if (set & UART_PIN_MASK(UART_PIN_DTR))
+            bits |= TIOCM_DTR;
 
-    entry = readdir(dir);
+        ret = ioctl(uart->fd, TIOCMBIS, &bits);
 
-    while (entry) {
-        if (strncmp(entry->d_name, "cuau", strlen("cuau")) == 0) {
-            if ((strnrcmp(entry->d_name, ".init", strlen(".init")) != 0) &&
-                (strnrcmp(entry->d_name, ".lock", strlen(".lock")) != 0)) {
-                    ctx->uarts[ctx->uarts_count] = (struct _uart *) malloc(sizeof(struct _uart));
+        if (ret == -1) {
+            _uart_error(ctx, uart, UART_ESYSAPI, "ioctl", "TIOCMBIS");
+
+            return UART_ESYSAPI;
+        }
+    }
 
-                    if (!ctx->uarts[ctx->uarts_count]) {
-                        _uart_error(ctx, NULL, UART_ENOMEM, NULL, NULL);
+    if (clear) {
+        bits = 0;
 
-                        return UART_ENOMEM;
-                    }
+        if (clear & UART_PIN_MASK(UART_PIN_RTS))
+            bits |= TIOCM_RTS;
 
-                    ctx->uarts[ctx->uarts_count]->errormsg = (char *) malloc(UART_ERRORMAX);
+        if (clear & UART_PIN_MASK(UART_PIN_DTR))
+            bits |= TIOCM_DTR;
 
-                    if (!ctx->uarts[ctx->uarts_count]->errormsg) {
-                        _uart_error(ctx, NULL, UART_ENOMEM, NULL, NULL);
+        ret = ioctl(uart->fd, TIOCMBIC, &bits);
 
-                        return UART_ENOMEM;
-                    }
+        if (ret == -1) {
+            _uart_error(ctx, uart, UART_ESYSAPI, "ioctl", "TIOCMBIC");
 
-                    memset(ctx->uarts[ctx->uarts_count], 0, sizeof(struct _uart));
-                    snprintf(ctx->uarts[ctx->uarts_count]->dev, UART_NAMEMAX, "/dev/%s", entry->d_name);
-                    ctx->uarts_count++;
-                }
+            return UART_ESYSAPI;
         }
-
-        entry = readdir(dir);
     }
 
-    closedir(dir);
-#else
-#error "Unsupported POSIX compatible operating system."
-#endif
-
     return UART_ESUCCESS;
 }
 
-int _uart_open(struct _uart_ctx *ctx, struct _uart *uart)
+int _uart_set_rs485(struct _uart_ctx *ctx, struct _uart *uart, const struct uart_rs485 *conf)
 {
+#ifdef __linux__
     int ret;
-    int fd;
-    struct termios options;
-    
+    struct serial_rs485 rs485;
+#endif
+
     if (!ctx) {
         return UART_ECTX;
     }
@@ -1181,94 +2919,70 @@ int _uart_open(struct _uart_ctx *ctx, struct _uart *uart)
         return UART_EHANDLE;
     }
 
-    fd = open(uart->dev, O_RDWR | O_NOCTTY | O_NDELAY);
-    
-    if (fd == -1) {
-        _uart_error(ctx, uart, UART_ESYSAPI, "open", NULL);
+    if ((conf->delay_before < 0) || (conf->delay_after < 0)) {
+        _uart_error(ctx, uart, UART_EINVAL, NULL, "RS-485 delay");
 
-        return UART_ESYSAPI;
+        return UART_EINVAL;
     }
-    
-    uart->fd = fd;
-
-    /* set non-blocking mode */
-    ret = fcntl(uart->fd, F_SETFL, O_NDELAY);
-
-    if (ret == -1) {
-        _uart_error(ctx, uart, UART_ESYSAPI, "fcntl", NULL);
 
-        return UART_ESYSAPI;
-    }
+#ifdef __linux__
+    if (!(conf->flags & UART_RS485_SOFTWARE)) {
+        memset(&rs485, 0, sizeof(rs485));
 
-    /* set baud rate */
-    ret = _uart_init_baud(ctx, uart);
+        if (conf->flags & UART_RS485_ENABLED)
+            rs485.flags |= SER_RS485_ENABLED;
 
-    if (ret != UART_ESUCCESS) {
-        return ret;
-    }
+        if (conf->flags & UART_RS485_RTS_ON_SEND)
+            rs485.flags |= SER_RS485_RTS_ON_SEND;
 
-    /* set data bits */
-    ret = _uart_init_databits(ctx, uart);
+        if (conf->flags & UART_RS485_RTS_AFTER_SEND)
+            rs485.flags |= SER_RS485_RTS_AFTER_SEND;
 
-    if (ret != UART_ESUCCESS) {
-        return ret;
-    }
+        if (conf->flags & UART_RS485_RX_DURING_TX)
+            rs485.flags |= SER_RS485_RX_DURING_TX;
 
-    /* set parity */
-    ret = _uart_init_parity(ctx, uart);
+        rs485.delay_rts_before_send = (unsigned int) conf->delay_before;
+        rs485.delay_rts_after_send = (unsigned int) conf->delay_after;
 
-    if (ret != UART_ESUCCESS) {
-        return ret;
-    }
+        ret = ioctl(uart->fd, TIOCSRS485, &rs485);
 
-    /* set stop bits */
-    ret = _uart_init_stopbits(ctx, uart);
+        if (ret == 0) {
+            uart->rs485 = *(conf);
 
-    if (ret != UART_ESUCCESS) {
-        return ret;
-    }
+            return UART_ESUCCESS;
+        }
 
-    /* set flow control */
-    ret = _uart_init_flow(ctx, uart);
+        /* other errors than a missing driver support are real errors */
+        if ((errno != ENOTTY) && (errno != EINVAL) && (errno != EOPNOTSUPP)) {
+            _uart_error(ctx, uart, UART_ESYSAPI, "ioctl", "TIOCSRS485");
 
-    if (ret != UART_ESUCCESS) {
-        return ret;
+            return UART_ESYSAPI;
+        }
     }
+#endif
 
-    ret = tcgetattr(uart->fd, &options);
+    uart->rs485 = *(conf);
 
-    if (ret == -1) {
-        _uart_error(ctx, uart, UART_ESYSAPI, "tcgetattr", NULL);
+    if (!(conf->flags & UART_RS485_ENABLED)) {
+        uart->rs485.flags &= ~UART_RS485_SOFTWARE;
 
-        return UART_ESYSAPI;
+        return UART_ESUCCESS;
     }
 
-    /* set raw mode (see man cfmakeraw) */
-    options.c_lflag &= ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
-    options.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP |
-    INLCR | IGNCR | ICRNL | IXON);
-    options.c_oflag &= ~OPOST;
-    options.c_cflag &= ~(CSIZE | PARENB);
-    options.c_cflag |= CS8;
-
-    /* enable receiver and set local mode */
-    options.c_cflag |= (CLOCAL | CREAD);
-
-    /* set raw output */
-    options.c_oflag &= ~OPOST;
-    ret = tcsetattr(uart->fd, TCSANOW, &options);
-
-    if (ret == -1) {
-        _uart_error(ctx, uart, UART_ESYSAPI, "tcsetattr", NULL);
+    uart->rs485.flags |= UART_RS485_SOFTWARE;
 
-        return UART_ESYSAPI;
+    /* idle direction until the next send */
+    if (conf->flags & UART_RS485_RTS_AFTER_SEND) {
+        return _uart_set_pins(ctx, uart, UART_PIN_MASK(UART_PIN_RTS), 0);
     }
-    
-    return UART_ESUCCESS;
+
+    return _uart_set_pins(ctx, uart, 0, UART_PIN_MASK(UART_PIN_RTS));
 }
 
-int _uart_close(struct _uart_ctx *ctx, struct _uart *uart)
+int _uart_rs485_begin(struct _uart_ctx *ctx, struct _uart *uart)
 {
+    int ret;
+
     if (!ctx) {
         return UART_ECTX;
     }
@@ -1279,49 +2993,31 @@ int _uart_close(struct _uart_ctx *ctx, struct _uart *uart)
         return UART_EHANDLE;
     }
 
-    close(uart->fd);
-
-    return UART_ESUCCESS;
-}
-
-#ifndef LIBUART_THREADS
-ssize_t _uart_send(struct _uart_ctx *ctx, struct _uart *uart, void *send_buf, size_t len)
-{
-    ssize_t ret;
-    
-    if (!ctx) {
-        return UART_ECTX;
+    if (!(uart->rs485.flags & UART_RS485_SOFTWARE)) {
+        return UART_ESUCCESS;
     }
 
-    if (!uart) {
-        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
-
-        return UART_EHANDLE;
+    if (uart->rs485.flags & UART_RS485_RTS_ON_SEND) {
+        ret = _uart_set_pins(ctx, uart, UART_PIN_MASK(UART_PIN_RTS), 0);
+    } else {
+        ret = _uart_set_pins(ctx, uart, 0, UART_PIN_MASK(UART_PIN_RTS));
     }
 
-    ret = write(uart->fd, send_buf, len);
-    
-    if (ret == -1) {
-        _uart_error(ctx, uart, UART_ESYSAPI, "write", NULL);
-
-        return UART_ESYSAPI;
+    if (ret != UART_ESUCCESS) {
+        return ret;
     }
-    
-    if (ret != (ssize_t) len) {
-        _uart_error(ctx, uart, UART_ESYSAPI, "write", "could not send all data");
 
-        return UART_ESYSAPI;
+    if (uart->rs485.delay_before > 0) {
+        usleep((useconds_t) uart->rs485.delay_before * 1000);
     }
-    
-    uart->error = UART_ESUCCESS;
 
-    return ret;
+    return UART_ESUCCESS;
 }
 
-ssize_t _uart_recv(struct _uart_ctx *ctx, struct _uart *uart, void *recv_buf, size_t len)
+int _uart_rs485_end(struct _uart_ctx *ctx, struct _uart *uart)
 {
-    ssize_t ret = 0;
-    
+    int ret;
+
     if (!ctx) {
         return UART_ECTX;
     }
@@ -1332,50 +3028,30 @@ ssize_t _uart_recv(struct _uart_ctx *ctx, struct _uart *uart, void *recv_buf, si
         return UART_EHANDLE;
     }
 
-    ret = read(uart->fd, recv_buf, len);
-    
-    if (ret == -1) {
-        _uart_error(ctx, uart, UART_ESYSAPI, "read", NULL);
-
-        return UART_ESYSAPI;
+    if (!(uart->rs485.flags & UART_RS485_SOFTWARE)) {
+        return UART_ESUCCESS;
     }
-    
-    uart->error = UART_ESUCCESS;
 
-    return ret;
-}
-#endif
+    /* turn around as soon as the last stop bit left the transmitter */
+    ret = _uart_drain(ctx, uart, -1);
 
-int _uart_flush(struct _uart_ctx *ctx, struct _uart *uart)
-{
-    int ret = 0;
-    
-    if (!ctx) {
-        return UART_ECTX;
+    if (ret != UART_ESUCCESS) {
+        return ret;
     }
 
-    if (!uart) {
-        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
-
-        return UART_EHANDLE;
+    if (uart->rs485.delay_after > 0) {
+        usleep((useconds_t) uart->rs485.delay_after * 1000);
     }
 
-    ret = fsync(uart->fd);
-    
-    if (ret == -1) {
-        _uart_error(ctx, uart, UART_ESYSAPI, "fsync", NULL);
-
-        return UART_ESYSAPI;
+    if (uart->rs485.flags & UART_RS485_RTS_AFTER_SEND) {
+        return _uart_set_pins(ctx, uart, UART_PIN_MASK(UART_PIN_RTS), 0);
     }
-    
-    return UART_ESUCCESS;
+
+    return _uart_set_pins(ctx, uart, 0, UART_PIN_MASK(UART_PIN_RTS));
 }
 
 int _uart_set_pin(struct _uart_ctx *ctx, struct _uart *uart, enum e_pins pin, int state)
 {
-    int ret;
-    int status;
-    
     if (!ctx) {
         return UART_ECTX;
     }
@@ -1386,42 +3062,21 @@ int _uart_set_pin(struct _uart_ctx *ctx, struct _uart *uart, enum e_pins pin, in
         return UART_EHANDLE;
     }
 
-    ret = ioctl(uart->fd, TIOCMGET, &status);
-    
-    if (ret == -1) {
-        _uart_error(ctx, uart, UART_ESYSAPI, "ioctl", NULL);
-
-        return UART_ESYSAPI;
-    }
-    
     switch (pin) {
     case UART_PIN_RTS:
-        if (state == UART_PIN_HIGH)
-            status |= TIOCM_RTS;
-        else
-            status &= ~TIOCM_RTS;
-        break;
     case UART_PIN_DTR:
-        if (state == UART_PIN_HIGH)
-            status |= TIOCM_DTR;
-        else
-            status &= ~TIOCM_DTR;
         break;
     default:
         _uart_error(ctx, uart, UART_EPIN, NULL, NULL);
 
         return UART_EPIN;
     }
-    
-    ioctl(uart->fd, TIOCMSET, status);
-    
-    if (ret == -1) {
-        _uart_error(ctx, uart, UART_ESYSAPI, "ioctl", NULL);
 
-        return UART_ESYSAPI;
+    if (state == UART_PIN_HIGH) {
+        return _uart_set_pins(ctx, uart, UART_PIN_MASK(pin), 0);
     }
-    
-    return UART_ESUCCESS;
+
+    return _uart_set_pins(ctx, uart, 0, UART_PIN_MASK(pin));
 }
 
 int _uart_get_pin(struct _uart_ctx *ctx, struct _uart *uart, enum e_pins pin, int *state)
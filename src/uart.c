@@ -23,6 +23,14 @@
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef __unix__
+#include <unistd.h>
+#include <limits.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/uio.h>
+#endif
+
 #include "_uart.h"
 #include "_version.h"
 #include "_util.h"
@@ -48,6 +56,8 @@ static int parse_option(uart_ctx_t *ctx, uart_t *uart, const char *opt)
         return UART_EHANDLE;
     }
 
+    uart->exclusive = 0;
+
     while (opt[i] != '\0') {
         /* parse data bits */
         switch (opt[i]) {
@@ -82,6 +92,12 @@ static int parse_option(uart_ctx_t *ctx, uart_t *uart, const char *opt)
         case 'E':
             uart->parity = UART_PARITY_EVEN;
             break;
+        case 'M':
+            uart->parity = UART_PARITY_MARK;
+            break;
+        case 'S':
+            uart->parity = UART_PARITY_SPACE;
+            break;
         default:
             _uart_error(ctx, uart, UART_EPARITY, NULL, "unsupported");
 
@@ -124,6 +140,12 @@ static int parse_option(uart_ctx_t *ctx, uart_t *uart, const char *opt)
         }
         
         i++;
+
+        /* optional exclusive access */
+        if (opt[i] == 'X') {
+            uart->exclusive = 1;
+            i++;
+        }
         
         if (opt[i] != '\0') {
             _uart_error(ctx, uart, UART_EOPT, NULL, NULL);
@@ -135,7 +157,60 @@ static int parse_option(uart_ctx_t *ctx, uart_t *uart, const char *opt)
     return UART_ESUCCESS;
 }
 
+static int scan_devices(uart_ctx_t *ctx)
+{
+    uart_t **uarts;
+    int ret;
+    int num = 0;
+    int i;
+
+    ret = _uart_get_device_list(ctx);
+
+    if (ret != UART_ESUCCESS) {
+        _uart_device_scan_reset(ctx);
+
+        return ret;
+    }
+
+    ret = _uart_device_merge(ctx);
+
+    if (ret != UART_ESUCCESS) {
+        return ret;
+    }
+
+    ctx->flags |= UART_CTXFSCANNED;
+
+    /* the identity is gathered once, for new (or returned) devices only */
+    if (ctx->added_count == 0) {
+        return UART_ESUCCESS;
+    }
+
+    uarts = (uart_t **) malloc((size_t) ctx->added_count * sizeof(uart_t *));
+
+    if (!uarts) {
+        _uart_error(ctx, NULL, UART_ENOMEM, NULL, NULL);
+
+        return UART_ENOMEM;
+    }
+
+    for (i = 0; (i < ctx->uarts_count) && (num < ctx->added_count); i++) {
+        if (!(ctx->uarts[i]->flags & UART_FINFO) && (ctx->uarts[i]->flags & UART_FSCANNED)) {
+            uarts[num++] = ctx->uarts[i];
+        }
+    }
+
+    _uart_get_device_info(ctx, uarts, num);
+    free(uarts);
+
+    return UART_ESUCCESS;
+}
+
 int UART_init(uart_ctx_t **ret_ctx)
+{
+    return UART_init_ex(ret_ctx, 0);
+}
+
+int UART_init_ex(uart_ctx_t **ret_ctx, unsigned int flags)
 {
     int ret;
     uart_ctx_t *ctx;
@@ -159,6 +234,9 @@ int UART_init(uart_ctx_t **ret_ctx)
     }
 
     memset(ctx->errormsg, 0, UART_ERRORMAX);
+#ifdef __unix__
+    ctx->hotplug_fd = -1;
+#endif
     ret = _uart_init(ctx);
 
     if (ret != UART_ESUCCESS) {
@@ -168,7 +246,16 @@ int UART_init(uart_ctx_t **ret_ctx)
     ctx->init_done = 1;
     ctx->flags |= UART_CTXFOKAY;
     *(ret_ctx) = ctx;
-    ret = _uart_get_device_list(ctx);
+
+    /**
+     * Without enumeration the device list stays empty until
+     * UART_get_device_list, UART_dev_open_name works without it.
+     */
+    if (flags & UART_INIT_LAZY) {
+        return UART_ESUCCESS;
+    }
+
+    ret = scan_devices(ctx);
 
     if (ret != UART_ESUCCESS) {
         return ret;
@@ -180,26 +267,25 @@ int UART_init(uart_ctx_t **ret_ctx)
 int UART_free(uart_ctx_t *ctx)
 {
     int ret;
-    int i;
 
     if (!ctx) {
         return UART_ECTX;
     }
 
-    for (i = 0; i < ctx->uarts_count; i++) {
-        ret = UART_dev_close(ctx, ctx->uarts[i]);
-
-        if (ret != UART_ESUCCESS) {
-            return ret;
-        }
-
-        ret = UART_dev_free(ctx, ctx->uarts[i]);
+    /* UART_dev_free removes the device from the table */
+    while (ctx->uarts_count > 0) {
+        ret = UART_dev_free(ctx, ctx->uarts[ctx->uarts_count - 1]);
 
         if (ret != UART_ESUCCESS) {
             return ret;
         }
     }
 
+#ifdef __unix__
+    _uart_hotplug_close(ctx);
+#endif
+    _uart_device_free(ctx);
+
     if (ctx->errormsg) {
         free(ctx->errormsg);
     }
@@ -210,260 +296,238 @@ int UART_free(uart_ctx_t *ctx)
 }
 
 ssize_t UART_get_device_list(uart_ctx_t *ctx, uart_t **ret_uarts)
+{
+    return UART_update_device_list(ctx, ret_uarts, NULL);
+}
+
+ssize_t UART_update_device_list(uart_ctx_t *ctx, uart_t **ret_uarts, struct uart_dev_changes *ret_changes)
 {
     int ret;
-    struct _uart *tmp_uarts[UART_DEVMAX];
-    int tmp_uarts_count = 0;
-    int i;
-    int j;
 
     if (!ctx) {
         return UART_ECTX;
     }
 
-    for (i = 0; i < ctx->uarts_count; i++) {
-        if (ctx->uarts[i]->flags & UART_FOPENED) {
-            tmp_uarts[tmp_uarts_count] = ctx->uarts[i];
-            tmp_uarts_count++;
-        } else {
-            free(ctx->uarts[i]->errormsg);
-            free(ctx->uarts[i]);
-        }
-    }
-
-    ret = _uart_get_device_list(ctx);
+    /* existing entries (opened or not) are kept, only changes are applied */
+    ret = scan_devices(ctx);
 
     if (ret != UART_ESUCCESS) {
         return ret;
     }
 
-    if (tmp_uarts_count) {
-        for (i = 0; i < ctx->uarts_count; i++) {
-            for (j = 0; j < tmp_uarts_count; j++) {
-                if (strcmp(tmp_uarts[j]->dev, ctx->uarts[i]->dev) == 0) {
-                    ctx->uarts[i]->flags |= UART_FOPENED;
-                }
-            }
-        }
+    if (ret_uarts) {
+        *(ret_uarts) = (uart_t *) ctx->uarts;
     }
 
-    *(ret_uarts) = (uart_t *) ctx->uarts;
+    if (ret_changes) {
+        ret_changes->added = ctx->added;
+        ret_changes->added_count = ctx->added_count;
+        ret_changes->removed = ctx->removed;
+        ret_changes->removed_count = ctx->removed_count;
+    }
 
     return (ssize_t) ctx->uarts_count;
 }
 
-uart_t *UART_dev_open_name(uart_ctx_t *ctx, const char *devname, enum e_baud baud, const char *opt)
+#ifdef __unix__
+int UART_hotplug_start(uart_ctx_t *ctx, uart_hotplug_cb cb, void *arg, int *ret_fd)
 {
-    uart_t *uart;
     int ret;
-    int i;
-    int found = 0;
 
     if (!ctx) {
-        return NULL;
+        return UART_ECTX;
     }
 
-    if (!devname) {
-        _uart_error(ctx, NULL, UART_EDEV, NULL, "NULL");
+    if (ctx->hotplug_fd != -1) {
+        _uart_error(ctx, NULL, UART_EINVAL, NULL, "hotplug already started");
 
-        return NULL;
+        return UART_EINVAL;
     }
 
-    if (ctx->uarts_count) {
-        for (i = 0; i < ctx->uarts_count; i++) {
-            if (strcmp(devname, ctx->uarts[i]->dev) == 0) {
-                if (ctx->uarts[i]->flags & UART_FOPENED) {
-                    return ctx->uarts[i];
-                } else {
-                    ret = parse_option(ctx, ctx->uarts[i], opt);
-
-                    if (ret != UART_ESUCCESS) {
-                        return NULL;
-                    }
-
-                    ctx->uarts[i]->baud = baud;
-                    ret = _uart_open(ctx, ctx->uarts[i]);
+    ret = _uart_hotplug_open(ctx);
 
-                    if (ret != UART_ESUCCESS) {
-                        return NULL;
-                    }
+    if (ret != UART_ESUCCESS) {
+        return ret;
+    }
 
-                    uart = ctx->uarts[i];
-                    found = 1;
-                    break;
-                }
-            }
-        }
+    /**
+     * Scan after the socket is open, so no device is missed between
+     * the scan and the first event (also for a lazy context).
+     */
+    ret = scan_devices(ctx);
 
-        if (!found) {
-            uart = (uart_t *) malloc(sizeof(uart_t));
+    if (ret != UART_ESUCCESS) {
+        _uart_hotplug_close(ctx);
 
-            if (!uart) {
-                _uart_error(ctx, NULL, UART_ENOMEM, NULL, NULL);
+        return ret;
+    }
 
-                return NULL;
-            }
+    ctx->hotplug_cb = cb;
+    ctx->hotplug_arg = arg;
 
-            memset(uart, 0, sizeof(uart_t));
-            uart->errormsg = (char *) malloc(UART_ERRORMAX);
+    if (ret_fd) {
+        *(ret_fd) = ctx->hotplug_fd;
+    }
 
-            if (!uart->errormsg) {
-                _uart_error(ctx, uart, UART_ENOMEM, NULL, NULL);
+    return UART_ESUCCESS;
+}
 
-                return NULL;
-            }
+int UART_hotplug_dispatch(uart_ctx_t *ctx, int timeout)
+{
+    struct pollfd pfd;
+    int ret;
+    int i;
 
-            ctx->uarts[ctx->uarts_count] = uart;
-            ctx->uarts_count++;
-            memset(uart->errormsg, 0, UART_ERRORMAX);
-            strcpy(uart->dev, devname);
-            ret = parse_option(ctx, uart, opt);
+    if (!ctx) {
+        return UART_ECTX;
+    }
 
-            if (ret != UART_ESUCCESS) {
-                free(uart);
+    if (ctx->hotplug_fd == -1) {
+        _uart_error(ctx, NULL, UART_EINVAL, NULL, "hotplug not started");
 
-                return NULL;
-            }
+        return UART_EINVAL;
+    }
 
-            uart->baud = baud;
-            ret = _uart_open(ctx, uart);
+    pfd.fd = ctx->hotplug_fd;
+    pfd.events = POLLIN;
 
-            if (ret != UART_ESUCCESS) {
-                free(uart);
+    ret = poll(&pfd, 1, timeout);
 
-                return NULL;
-            }
+    if (ret == -1) {
+        if (errno == EINTR) {
+            return 0;
         }
-    } else {
-        uart = (uart_t *) malloc(sizeof(uart_t));
 
-        if (!uart) {
-            _uart_error(ctx, NULL, UART_ENOMEM, NULL, NULL);
+        _uart_error(ctx, NULL, UART_ESYSAPI, "poll", NULL);
 
-            return NULL;
-        }
+        return UART_ESYSAPI;
+    }
 
-        memset(uart, 0, sizeof(uart_t));
-        uart->errormsg = (char *) malloc(UART_ERRORMAX);
+    if (ret == 0) {
+        return 0;
+    }
 
-        if (!uart->errormsg) {
-            _uart_error(ctx, uart, UART_ENOMEM, NULL, NULL);
+    ret = _uart_hotplug_read(ctx);
 
-            return NULL;
-        }
+    if (ret <= 0) {
+        return ret;
+    }
 
-        ctx->uarts[ctx->uarts_count] = uart;
-        ctx->uarts_count++;
-        memset(uart->errormsg, 0, UART_ERRORMAX);
-        strcpy(uart->dev, devname);
-        ret = parse_option(ctx, uart, opt);
+    /* a burst of events results in a single (incremental) rescan */
+    ret = scan_devices(ctx);
 
-        if (ret != UART_ESUCCESS) {
-            free(uart);
+    if (ret != UART_ESUCCESS) {
+        return ret;
+    }
 
-            return NULL;
+    if (ctx->hotplug_cb) {
+        for (i = 0; i < ctx->added_count; i++) {
+            ctx->hotplug_cb(ctx, ctx->added[i], UART_HOTPLUG_ADD, ctx->hotplug_arg);
         }
 
-        uart->baud = baud;
-        ret = _uart_open(ctx, uart);
-
-        if (ret != UART_ESUCCESS) {
-            free(uart);
-
-            return NULL;
+        for (i = 0; i < ctx->removed_count; i++) {
+            ctx->hotplug_cb(ctx, ctx->removed[i], UART_HOTPLUG_REMOVE, ctx->hotplug_arg);
         }
     }
 
-#ifdef LIBUART_THREADS
-    if (!(uart->flags & UART_FOPENED)) {
-        uart->rx_buffer = buffer_create(UART_BUFFERSIZE);
-
-        if (!uart->rx_buffer) {
-            _uart_error(ctx, uart, UART_EBUF, NULL, NULL);
-
-            return NULL;
-        }
+    return ctx->added_count + ctx->removed_count;
+}
 
-        uart->tx_buffer = buffer_create(UART_BUFFERSIZE);
+int UART_hotplug_stop(uart_ctx_t *ctx)
+{
+    if (!ctx) {
+        return UART_ECTX;
+    }
 
-        if (!uart->tx_buffer) {
-            _uart_error(ctx, uart, UART_EBUF, NULL, NULL);
+    _uart_hotplug_close(ctx);
+    ctx->hotplug_cb = NULL;
+    ctx->hotplug_arg = NULL;
 
-            return NULL;
-        }
+    return UART_ESUCCESS;
+}
+#endif
 
-        ret = _uart_thread_init(ctx, uart);
+/**
+ * Find the device table entry for a device name, or add a new one
+ */
+static uart_t *open_lookup(uart_ctx_t *ctx, const char *devname, int *ret_created)
+{
+    uart_t *uart;
+#ifdef __unix__
+    char path[PATH_MAX];
+#endif
 
-        if (ret != UART_ESUCCESS) {
-            return NULL;
-        }
+    *(ret_created) = 0;
 
-        ret = _uart_thread_start(ctx, uart);
+    if (!devname) {
+        _uart_error(ctx, NULL, UART_EDEV, NULL, "NULL");
 
-        if (ret != UART_ESUCCESS) {
-            return NULL;
-        }
+        return NULL;
     }
-#endif
-
-    uart->flags |= UART_FOPENED;
 
-    return uart;
-}
-
-int UART_dev_open(uart_ctx_t *ctx, uart_t *uart, enum e_baud baud, const char *opt)
-{
-    int ret;
-    int i;
-    int found = 0;
+    if (strlen(devname) >= UART_NAMEMAX) {
+        _uart_error(ctx, NULL, UART_EDEV, NULL, "device name too long");
 
-    if (!ctx) {
-        return UART_ECTX;
+        return NULL;
     }
 
-    if (!uart) {
-        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+    uart = _uart_device_lookup(ctx, devname);
 
-        return UART_EHANDLE;
+    if (uart) {
+        return uart;
     }
 
-    if (ctx->uarts_count) {
-        for (i = 0; i < ctx->uarts_count; i++) {
-            if (ctx->uarts[i] == uart) {
-                found = 1;
-                break;
-            }
-        }
-
-        if (!found) {
-            _uart_error(ctx, NULL, UART_EDEV, NULL, NULL);
+#ifdef __unix__
+    /**
+     * The table key is always the tty node, a later scan must find the
+     * entry of a device opened by a link (e.g. '/dev/serial/by-id').
+     */
+    if (realpath(devname, path) && (strlen(path) < UART_NAMEMAX)) {
+        devname = path;
+    }
+#endif
 
-            return UART_EDEV;
-        }
-    } else {
-        _uart_error(ctx, NULL, UART_EDEV, NULL, NULL);
+    /* not enumerated (yet), add it to the device table */
+    uart = _uart_device_new(ctx, devname);
 
-        return UART_EDEV;
+    if (!uart) {
+        return NULL;
     }
 
-    if (!(uart->flags & UART_FOPENED)) {
-        ret = parse_option(ctx, uart, opt);
+    if (_uart_device_insert(ctx, uart) != UART_ESUCCESS) {
+        free(uart->errormsg);
+        free(uart);
 
-        if (ret != UART_ESUCCESS) {
-            free(uart);
+        return NULL;
+    }
 
-            return ret;
-        }
+    *(ret_created) = 1;
 
-        uart->baud = baud;
-        ret = _uart_open(ctx, uart);
+    return uart;
+}
 
-        if (ret != UART_ESUCCESS) {
-            return ret;
-        }
-    }
+/**
+ * Drop a device table entry added by open_lookup after a failed open
+ */
+static void open_discard(uart_ctx_t *ctx, uart_t *uart)
+{
+    /* keep the reason (e.g. the owner of a busy device) in the context */
+    ctx->error = uart->error;
+    memcpy(ctx->errormsg, uart->errormsg, UART_ERRORMAX);
+    ctx->flags |= UART_CTXFERROR;
+    _uart_device_remove(ctx, uart);
+    free(uart->errormsg);
+    free(uart);
+}
 
+/**
+ * Start the worker threads of an opened device and mark it as opened
+ */
+static int open_finish(uart_ctx_t *ctx, uart_t *uart)
+{
 #ifdef LIBUART_THREADS
+    int ret;
+
     if (!(uart->flags & UART_FOPENED)) {
         uart->rx_buffer = buffer_create(UART_BUFFERSIZE);
 
@@ -493,6 +557,8 @@ int UART_dev_open(uart_ctx_t *ctx, uart_t *uart, enum e_baud baud, const char *o
             return ret;
         }
     }
+#else
+    (void) ctx;
 #endif
 
     uart->flags |= UART_FOPENED;
@@ -500,45 +566,324 @@ int UART_dev_open(uart_ctx_t *ctx, uart_t *uart, enum e_baud baud, const char *o
     return UART_ESUCCESS;
 }
 
-int UART_dev_close(uart_ctx_t *ctx, uart_t *uart)
+uart_t *UART_dev_open_name(uart_ctx_t *ctx, const char *devname, enum e_baud baud, const char *opt)
 {
+    uart_t *uart;
     int ret;
+    int created;
 
     if (!ctx) {
-        return UART_ECTX;
+        return NULL;
     }
 
-    if (!uart) {
-        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+    uart = open_lookup(ctx, devname, &created);
 
-        return UART_EHANDLE;
+    if (!uart) {
+        return NULL;
     }
 
     if (uart->flags & UART_FOPENED) {
-#ifdef LIBUART_THREADS
-        ret = _uart_thread_stop(ctx, uart);
-
-        if (ret != UART_ESUCCESS) {
-            return ret;
-        }
+        return uart;
+    }
 
-        buffer_free(uart->rx_buffer);
-        buffer_free(uart->tx_buffer);
-#endif
+    ret = parse_option(ctx, uart, opt);
 
-        ret = _uart_flush(ctx, uart);
+    if (ret == UART_ESUCCESS) {
+        uart->baud = baud;
+        ret = _uart_open(ctx, uart);
+    }
 
-        if (ret != UART_ESUCCESS) {
-            return ret;
+    if (ret != UART_ESUCCESS) {
+        if (created) {
+            open_discard(ctx, uart);
         }
 
-        ret = _uart_close(ctx, uart);
+        return NULL;
+    }
 
-        if (ret != UART_ESUCCESS) {
-            return ret;
-        }
+    ret = open_finish(ctx, uart);
 
+    if (ret != UART_ESUCCESS) {
+        return NULL;
+    }
+
+    return uart;
+}
+
+int UART_dev_open_many(uart_ctx_t *ctx, struct uart_open_req *reqs, int count)
+{
+    uart_t **uarts;
+    int *rets;
+    int *idx;
+    int *created;
+    int num = 0;
+    int opened = 0;
+    int i;
+
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!reqs || (count < 0)) {
+        _uart_error(ctx, NULL, UART_EINVAL, NULL, "requests");
+
+        return UART_EINVAL;
+    }
+
+    uarts = (uart_t **) malloc((size_t) (count + 1) * sizeof(uart_t *));
+    rets = (int *) malloc((size_t) (count + 1) * sizeof(int));
+    idx = (int *) malloc((size_t) (count + 1) * sizeof(int));
+    created = (int *) malloc((size_t) (count + 1) * sizeof(int));
+
+    if (!uarts || !rets || !idx || !created) {
+        free(uarts);
+        free(rets);
+        free(idx);
+        free(created);
+        _uart_error(ctx, NULL, UART_ENOMEM, NULL, NULL);
+
+        return UART_ENOMEM;
+    }
+
+    /* table lookups and option parsing aren't thread safe, do them first */
+    for (i = 0; i < count; i++) {
+        reqs[i].uart = open_lookup(ctx, reqs[i].dev, &created[i]);
+        reqs[i].error = UART_ESUCCESS;
+
+        if (!reqs[i].uart) {
+            reqs[i].error = ctx->error;
+
+            continue;
+        }
+
+        /* already opened (or requested twice) */
+        if (reqs[i].uart->flags & (UART_FOPENED | UART_FPENDING)) {
+            continue;
+        }
+
+        reqs[i].error = parse_option(ctx, reqs[i].uart, reqs[i].opt);
+
+        if (reqs[i].error != UART_ESUCCESS) {
+            continue;
+        }
+
+        reqs[i].uart->baud = reqs[i].baud;
+        reqs[i].uart->flags |= UART_FPENDING;
+        uarts[num] = reqs[i].uart;
+        idx[num] = i;
+        num++;
+    }
+
+    /* the opens are dominated by (USB) round trips, run them concurrently */
+#if defined(LIBUART_THREADS) && defined(__unix__)
+    _uart_thread_open_many(ctx, uarts, rets, num);
+#else
+    for (i = 0; i < num; i++) {
+        rets[i] = _uart_open(ctx, uarts[i]);
+    }
+#endif
+
+    for (i = 0; i < num; i++) {
+        uarts[i]->flags &= ~(UART_FPENDING);
+
+        if (rets[i] == UART_ESUCCESS) {
+            rets[i] = open_finish(ctx, uarts[i]);
+        }
+
+        reqs[idx[i]].error = rets[i];
+    }
+
+    /**
+     * Failed requests (and their duplicates) return no handle, entries
+     * added for them are dropped after the last reference is gone.
+     */
+    num = 0;
+
+    for (i = 0; i < count; i++) {
+        if (reqs[i].uart && !(reqs[i].uart->flags & UART_FOPENED)) {
+            if (reqs[i].error == UART_ESUCCESS) {
+                reqs[i].error = reqs[i].uart->error;
+            }
+
+            if (created[i]) {
+                uarts[num++] = reqs[i].uart;
+            }
+
+            reqs[i].uart = NULL;
+        }
+
+        if (reqs[i].uart) {
+            opened++;
+        }
+    }
+
+    for (i = 0; i < num; i++) {
+        open_discard(ctx, uarts[i]);
+    }
+
+    free(uarts);
+    free(rets);
+    free(idx);
+    free(created);
+
+    return opened;
+}
+
+int UART_dev_open(uart_ctx_t *ctx, uart_t *uart, enum e_baud baud, const char *opt)
+{
+    int ret;
+
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+    if (_uart_device_lookup(ctx, uart->dev) != uart) {
+        _uart_error(ctx, NULL, UART_EDEV, NULL, NULL);
+
+        return UART_EDEV;
+    }
+
+    if (!(uart->flags & UART_FOPENED)) {
+        ret = parse_option(ctx, uart, opt);
+
+        if (ret != UART_ESUCCESS) {
+            return ret;
+        }
+
+        uart->baud = baud;
+        ret = _uart_open(ctx, uart);
+
+        if (ret != UART_ESUCCESS) {
+            return ret;
+        }
+    }
+
+    ret = open_finish(ctx, uart);
+
+    if (ret != UART_ESUCCESS) {
+        return ret;
+    }
+
+    return UART_ESUCCESS;
+}
+
+static int info_match(const struct uart_dev_info *info, const struct uart_dev_info *match)
+{
+    if ((match->driver[0] != '\0') && (strcmp(info->driver, match->driver) != 0)) {
+        return 0;
+    }
+
+    if ((match->vid != UART_INFO_ANY) && (info->vid != match->vid)) {
+        return 0;
+    }
+
+    if ((match->pid != UART_INFO_ANY) && (info->pid != match->pid)) {
+        return 0;
+    }
+
+    if ((match->serial[0] != '\0') && (strcmp(info->serial, match->serial) != 0)) {
+        return 0;
+    }
+
+    if ((match->interface != UART_INFO_ANY) && (info->interface != match->interface)) {
+        return 0;
+    }
+
+    if ((match->by_id[0] != '\0') && (strcmp(info->by_id, match->by_id) != 0)) {
+        return 0;
+    }
+
+    if ((match->by_path[0] != '\0') && (strcmp(info->by_path, match->by_path) != 0)) {
+        return 0;
+    }
+
+    return 1;
+}
+
+uart_t *UART_find_device(uart_ctx_t *ctx, const struct uart_dev_info *match)
+{
+    uart_t *uart;
+    int i;
+
+    if (!ctx) {
+        return NULL;
+    }
+
+    if (!match) {
+        _uart_error(ctx, NULL, UART_EINVAL, NULL, "match");
+
+        return NULL;
+    }
+
+    if (!(ctx->flags & UART_CTXFSCANNED)) {
+        if (scan_devices(ctx) != UART_ESUCCESS) {
+            return NULL;
+        }
+    }
+
+    for (i = 0; i < ctx->uarts_count; i++) {
+        uart = ctx->uarts[i];
+
+        /* devices opened by name get their identity on first use */
+        if (!(uart->flags & UART_FINFO)) {
+            _uart_get_device_info(ctx, &uart, 1);
+        }
+
+        if (!(uart->flags & UART_FGONE) && info_match(&uart->info, match)) {
+            return uart;
+        }
+    }
+
+    return NULL;
+}
+
+int UART_dev_close(uart_ctx_t *ctx, uart_t *uart)
+{
+    int ret;
+
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+    if (uart->flags & UART_FOPENED) {
+#ifdef LIBUART_THREADS
+        ret = _uart_thread_stop(ctx, uart);
+
+        if (ret != UART_ESUCCESS) {
+            return ret;
+        }
+
+        buffer_free(uart->rx_buffer);
+        buffer_free(uart->tx_buffer);
+        uart->rx_buffer = NULL;
+        uart->tx_buffer = NULL;
+#endif
+
+        /* a failed flush (hung up, flow control) must not keep it open */
+#ifdef __unix__
+        _uart_drain_discard(ctx, uart, UART_FLUSHTIMEOUT);
+#else
+        _uart_flush(ctx, uart);
+#endif
+
+        ret = _uart_close(ctx, uart);
         uart->flags &= ~(UART_FOPENED);
+
+        if (ret != UART_ESUCCESS) {
+            return ret;
+        }
     }
 
     return UART_ESUCCESS;
@@ -564,6 +909,7 @@ int UART_dev_free(uart_ctx_t *ctx, uart_t *uart)
         return ret;
     }
 
+    _uart_device_remove(ctx, uart);
     free(uart->errormsg);
     free(uart);
 
@@ -585,13 +931,20 @@ ssize_t UART_send(uart_ctx_t *ctx, uart_t *uart, void *send_buf, size_t len)
     }
 
 #ifndef LIBUART_THREADS
+#ifdef __unix__
+    _uart_rs485_begin(ctx, uart);
+    ret = _uart_send(ctx, uart, send_buf, len);
+    _uart_rs485_end(ctx, uart);
+#else
     ret = _uart_send(ctx, uart, send_buf, len);
+#endif
 #else
     _uart_thread_lock_tx(ctx, uart);
 
     if (buffer_get_free(uart->tx_buffer) >= (ssize_t) len) {
         ret = buffer_wr(uart->tx_buffer, send_buf, (ssize_t) len);
     } else {
+        _uart_thread_unlock_tx(ctx, uart);
         _uart_error(ctx, uart, UART_EBUF, NULL, "full");
 
         return UART_EBUF;
@@ -623,7 +976,7 @@ ssize_t UART_recv(uart_ctx_t *ctx, uart_t *uart, void *recv_buf, size_t len)
     _uart_thread_lock_rx(ctx, uart);
 
     if (buffer_get_num(uart->rx_buffer) == 0) {
-        return 0;
+        ret = 0;
     } else {
         if (buffer_get_num(uart->rx_buffer) < (ssize_t) len) {
             ret = buffer_rd(uart->rx_buffer, recv_buf, buffer_get_num(uart->rx_buffer));
@@ -632,13 +985,794 @@ ssize_t UART_recv(uart_ctx_t *ctx, uart_t *uart, void *recv_buf, size_t len)
         }
     }
 
-    _uart_thread_unlock_rx(ctx, uart);
+    _uart_thread_unlock_rx(ctx, uart);
+#endif
+
+    return ret;
+}
+
+#ifdef __unix__
+ssize_t UART_send_timeout(uart_ctx_t *ctx, uart_t *uart, void *send_buf, size_t len, int timeout)
+{
+    ssize_t ret;
+#ifdef LIBUART_THREADS
+    size_t sent = 0;
+    ssize_t num;
+    long long deadline = 0;
+    unsigned char *p;
+#endif
+
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+#ifndef LIBUART_THREADS
+    _uart_rs485_begin(ctx, uart);
+    ret = _uart_send_timeout(ctx, uart, send_buf, len, timeout);
+    _uart_rs485_end(ctx, uart);
+#else
+    if (timeout >= 0) {
+        deadline = time_get_ms() + timeout;
+    }
+
+    p = (unsigned char *) send_buf;
+
+    /**
+     * Queue as much as fits and wait for the TX worker to make room, the
+     * returned count are the bytes queued in the transmit buffer.
+     */
+    _uart_thread_lock_tx(ctx, uart);
+
+    while (sent < len) {
+        num = buffer_get_free(uart->tx_buffer);
+
+        if (num > (ssize_t) (len - sent)) {
+            num = (ssize_t) (len - sent);
+        }
+
+        if (num > 0) {
+            buffer_wr(uart->tx_buffer, p + sent, num);
+            sent += (size_t) num;
+        }
+
+        if (sent == len) {
+            break;
+        }
+
+        if (_uart_thread_wait_tx(ctx, uart, (timeout >= 0) ? deadline : -1) == UART_ETIMEOUT) {
+            _uart_thread_unlock_tx(ctx, uart);
+            _uart_error(ctx, uart, UART_ETIMEOUT, NULL, "could not send all data");
+
+            return (ssize_t) sent;
+        }
+    }
+
+    _uart_thread_unlock_tx(ctx, uart);
+
+    ret = (ssize_t) sent;
+#endif
+
+    return ret;
+}
+#endif
+
+#ifdef __unix__
+ssize_t UART_sendv(uart_ctx_t *ctx, uart_t *uart, const struct iovec *iov, int iovcnt)
+{
+    ssize_t ret;
+#ifdef LIBUART_THREADS
+    size_t len = 0;
+    int i;
+#endif
+
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+    if (!iov || (iovcnt < 0)) {
+        _uart_error(ctx, uart, UART_EINVAL, NULL, "iovec");
+
+        return UART_EINVAL;
+    }
+
+#ifndef LIBUART_THREADS
+    _uart_rs485_begin(ctx, uart);
+    ret = _uart_sendv(ctx, uart, iov, iovcnt);
+    _uart_rs485_end(ctx, uart);
+#else
+    for (i = 0; i < iovcnt; i++) {
+        len += iov[i].iov_len;
+    }
+
+    /* queue all buffers in one locked section, so the data isn't interleaved */
+    _uart_thread_lock_tx(ctx, uart);
+
+    if (buffer_get_free(uart->tx_buffer) < (ssize_t) len) {
+        _uart_thread_unlock_tx(ctx, uart);
+        _uart_error(ctx, uart, UART_EBUF, NULL, "full");
+
+        return UART_EBUF;
+    }
+
+    for (i = 0; i < iovcnt; i++) {
+        if (iov[i].iov_len) {
+            buffer_wr(uart->tx_buffer, iov[i].iov_base, (ssize_t) iov[i].iov_len);
+        }
+    }
+
+    _uart_thread_unlock_tx(ctx, uart);
+    ret = (ssize_t) len;
+#endif
+
+    return ret;
+}
+
+ssize_t UART_recvv(uart_ctx_t *ctx, uart_t *uart, const struct iovec *iov, int iovcnt)
+{
+    ssize_t ret;
+#ifdef LIBUART_THREADS
+    ssize_t num;
+    ssize_t len;
+    int i;
+#endif
+
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+    if (!iov || (iovcnt < 0)) {
+        _uart_error(ctx, uart, UART_EINVAL, NULL, "iovec");
+
+        return UART_EINVAL;
+    }
+
+#ifndef LIBUART_THREADS
+    ret = _uart_recvv(ctx, uart, iov, iovcnt);
+#else
+    ret = 0;
+    _uart_thread_lock_rx(ctx, uart);
+    num = buffer_get_num(uart->rx_buffer);
+
+    for (i = 0; (i < iovcnt) && (num > 0); i++) {
+        len = (ssize_t) iov[i].iov_len;
+
+        if (len > num) {
+            len = num;
+        }
+
+        if (len > 0) {
+            buffer_rd(uart->rx_buffer, iov[i].iov_base, len);
+            num -= len;
+            ret += len;
+        }
+    }
+
+    _uart_thread_unlock_rx(ctx, uart);
+#endif
+
+    return ret;
+}
+#endif
+
+ssize_t UART_puts(uart_ctx_t *ctx, uart_t *uart, char *msg)
+{
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+    return UART_send(ctx, uart, msg, strlen(msg));
+}
+
+int UART_putc(uart_ctx_t *ctx, uart_t *uart, char c)
+{
+    ssize_t ret;
+
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+    ret = UART_send(ctx, uart, &c, 1);
+
+    if (ret != 1) {
+        return ret;
+    }
+
+    return UART_ESUCCESS;
+}
+
+int UART_getc(uart_ctx_t *ctx, uart_t *uart, char *ret_c)
+{
+    ssize_t ret;
+    char c[1];
+
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+    ret = UART_recv(ctx, uart, c, 1);
+
+    if (ret != 1) {
+        return ret;
+    }
+
+    *(ret_c) = c[0];
+
+    return UART_ESUCCESS;
+}
+
+int UART_flush(uart_ctx_t *ctx, uart_t *uart)
+{
+    int ret;
+
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+    ret = _uart_flush(ctx, uart);
+
+    if (ret != UART_ESUCCESS) {
+        return ret;
+    }
+
+    return UART_ESUCCESS;
+}
+
+#ifdef __unix__
+int UART_drain(uart_ctx_t *ctx, uart_t *uart, int timeout)
+{
+    int ret;
+#ifdef LIBUART_THREADS
+    long long start;
+#endif
+
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+#ifdef LIBUART_THREADS
+    /* first wait for the TX worker, then for the kernel and the hardware */
+    start = time_get_ms();
+    ret = _uart_thread_pause_tx(ctx, uart, timeout);
+
+    if (ret != UART_ESUCCESS) {
+        return ret;
+    }
+
+    _uart_thread_unlock_tx(ctx, uart);
+
+    if (timeout >= 0) {
+        timeout -= (int) (time_get_ms() - start);
+
+        if (timeout < 0) {
+            timeout = 0;
+        }
+    }
+#endif
+
+    ret = _uart_drain(ctx, uart, timeout);
+
+    if (ret != UART_ESUCCESS) {
+        return ret;
+    }
+
+    return UART_ESUCCESS;
+}
+#endif
+
+int UART_set_pin(uart_ctx_t *ctx, uart_t *uart, enum e_pins pin, int state)
+{
+    int ret;
+
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+    ret = _uart_set_pin(ctx, uart, pin, state);
+
+    if (ret != UART_ESUCCESS) {
+        return ret;
+    }
+
+    return UART_ESUCCESS;
+}
+
+int UART_get_pin(uart_ctx_t *ctx, uart_t *uart, enum e_pins pin, int *ret_state)
+{
+    int ret;
+
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+    if (!ret_state) {
+        _uart_error(ctx, uart, UART_EINVAL, NULL, "int pointer (NULL)");
+
+        return UART_EINVAL;
+    }
+
+    ret = _uart_get_pin(ctx, uart, pin, ret_state);
+
+    if (ret != UART_ESUCCESS) {
+        return ret;
+    }
+
+    return UART_ESUCCESS;
+}
+
+#ifdef __unix__
+/**
+ * Multidrop mode owns the data bits and the parity until it is disabled
+ */
+static int multidrop_active(uart_ctx_t *ctx, uart_t *uart)
+{
+#ifdef __unix__
+    if ((uart->flags & UART_FOPENED) && (uart->md_addr >= 0)) {
+        _uart_error(ctx, uart, UART_EINVAL, NULL, "multidrop mode enabled");
+
+        return 1;
+    }
+#else
+    (void) ctx;
+    (void) uart;
+#endif
+
+    return 0;
+}
+
+static int set_config(uart_ctx_t *ctx, uart_t *uart, enum e_baud baud, const char *opt, int drain)
+{
+    int ret;
+    enum e_baud baud_old;
+    enum e_data data_bits_old;
+    enum e_parity parity_old;
+    enum e_stop stop_bits_old;
+    enum e_flow flow_ctrl_old;
+    int exclusive;
+
+    ret = _uart_baud_valid((int) baud);
+
+    if (ret == 0) {
+        _uart_error(ctx, uart, UART_EBAUD, NULL, NULL);
+
+        return UART_EBAUD;
+    }
+
+    if (multidrop_active(ctx, uart)) {
+        return UART_EINVAL;
+    }
+
+    baud_old = uart->baud;
+    data_bits_old = uart->data_bits;
+    parity_old = uart->parity;
+    stop_bits_old = uart->stop_bits;
+    flow_ctrl_old = uart->flow_ctrl;
+
+    /* without an option string only the baud rate is changed */
+    if (opt) {
+        /* the locks are taken by the open, 'X' only applies there */
+        exclusive = uart->exclusive;
+        ret = parse_option(ctx, uart, opt);
+        uart->exclusive = exclusive;
+    } else {
+        ret = UART_ESUCCESS;
+    }
+
+    if (ret == UART_ESUCCESS) {
+        uart->baud = baud;
+        ret = _uart_configure(ctx, uart, drain);
+    }
+
+    if (ret != UART_ESUCCESS) {
+        uart->baud = baud_old;
+        uart->data_bits = data_bits_old;
+        uart->parity = parity_old;
+        uart->stop_bits = stop_bits_old;
+        uart->flow_ctrl = flow_ctrl_old;
+
+        return ret;
+    }
+
+    return UART_ESUCCESS;
+}
+
+int UART_configure(uart_ctx_t *ctx, uart_t *uart, enum e_baud baud, const char *opt)
+{
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+    return set_config(ctx, uart, baud, opt, 0);
+}
+
+int UART_reconfigure(uart_ctx_t *ctx, uart_t *uart, enum e_baud baud, const char *opt, int timeout)
+{
+    int ret;
+
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+#ifndef LIBUART_THREADS
+    (void) timeout;
+    ret = set_config(ctx, uart, baud, opt, 1);
+#else
+    /**
+     * Pause the TX worker after the last queued message, then let the
+     * kernel drain its output queue before the new settings are applied
+     * (TCSADRAIN). The RX worker keeps running.
+     */
+    ret = _uart_thread_pause_tx(ctx, uart, timeout);
+
+    if (ret != UART_ESUCCESS) {
+        return ret;
+    }
+
+    ret = set_config(ctx, uart, baud, opt, 1);
+    _uart_thread_unlock_tx(ctx, uart);
+#endif
+
+    return ret;
+}
+#endif
+
+#ifdef __unix__
+int UART_set_multidrop(uart_ctx_t *ctx, uart_t *uart, int address)
+{
+    int ret;
+
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+#ifndef LIBUART_THREADS
+    ret = _uart_set_multidrop(ctx, uart, address);
+#else
+    /* the RX worker filters while holding rx_lock */
+    _uart_thread_lock_rx(ctx, uart);
+    ret = _uart_set_multidrop(ctx, uart, address);
+    _uart_thread_unlock_rx(ctx, uart);
+#endif
+
+    if (ret != UART_ESUCCESS) {
+        return ret;
+    }
+
+    return UART_ESUCCESS;
+}
+
+int UART_send_break(uart_ctx_t *ctx, uart_t *uart, int duration)
+{
+    int ret;
+
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+#ifndef LIBUART_THREADS
+    ret = _uart_send_break(ctx, uart, duration);
+#else
+    /* data queued before the break is sent first */
+    ret = _uart_thread_pause_tx(ctx, uart, -1);
+
+    if (ret != UART_ESUCCESS) {
+        return ret;
+    }
+
+    ret = _uart_send_break(ctx, uart, duration);
+    _uart_thread_unlock_tx(ctx, uart);
+#endif
+
+    if (ret != UART_ESUCCESS) {
+        return ret;
+    }
+
+    return UART_ESUCCESS;
+}
+
+int UART_send_address(uart_ctx_t *ctx, uart_t *uart, unsigned char address)
+{
+    int ret;
+
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+#ifndef LIBUART_THREADS
+    ret = _uart_send_address(ctx, uart, address);
+#else
+    /* queued data must leave with the old address selected */
+    ret = _uart_thread_pause_tx(ctx, uart, UART_ADDRTIMEOUT);
+
+    if (ret != UART_ESUCCESS) {
+        return ret;
+    }
+
+    ret = _uart_send_address(ctx, uart, address);
+    _uart_thread_unlock_tx(ctx, uart);
+#endif
+
+    if (ret != UART_ESUCCESS) {
+        return ret;
+    }
+
+    return UART_ESUCCESS;
+}
+
+int UART_set_rx_errors(uart_ctx_t *ctx, uart_t *uart, int mask)
+{
+    int ret;
+
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+#ifndef LIBUART_THREADS
+    ret = _uart_set_rx_errors(ctx, uart, mask);
+#else
+    _uart_thread_lock_rx(ctx, uart);
+    ret = _uart_set_rx_errors(ctx, uart, mask);
+    _uart_thread_unlock_rx(ctx, uart);
+#endif
+
+    if (ret != UART_ESUCCESS) {
+        return ret;
+    }
+
+    return UART_ESUCCESS;
+}
+
+int UART_get_rx_errors(uart_ctx_t *ctx, uart_t *uart, struct uart_rx_error *ret_errors, int max, unsigned long *ret_lost)
+{
+    int ret;
+
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+    if (!ret_errors || (max < 0)) {
+        _uart_error(ctx, uart, UART_EINVAL, NULL, "error records");
+
+        return UART_EINVAL;
+    }
+
+#ifndef LIBUART_THREADS
+    ret = _uart_get_rx_errors(uart, ret_errors, max, ret_lost);
+#else
+    _uart_thread_lock_rx(ctx, uart);
+    ret = _uart_get_rx_errors(uart, ret_errors, max, ret_lost);
+    _uart_thread_unlock_rx(ctx, uart);
+#endif
+
+    return ret;
+}
+
+int UART_set_latency(uart_ctx_t *ctx, uart_t *uart, const struct uart_latency *lat)
+{
+    int ret;
+
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+    if (!lat) {
+        _uart_error(ctx, uart, UART_EINVAL, NULL, "latency profile (NULL)");
+
+        return UART_EINVAL;
+    }
+
+    ret = _uart_set_latency(ctx, uart, lat);
+
+    if (ret != UART_ESUCCESS) {
+        return ret;
+    }
+
+    return UART_ESUCCESS;
+}
+
+int UART_set_pins(uart_ctx_t *ctx, uart_t *uart, int set_mask, int clear_mask)
+{
+    int ret;
+
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+    ret = _uart_set_pins(ctx, uart, set_mask, clear_mask);
+
+    if (ret != UART_ESUCCESS) {
+        return ret;
+    }
+
+    return UART_ESUCCESS;
+}
+
+int UART_set_pin_sequence(uart_ctx_t *ctx, uart_t *uart, const struct uart_pin_step *steps, int count)
+{
+    int i;
+    int ret;
+
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+    if (!steps || count < 0) {
+        _uart_error(ctx, uart, UART_EINVAL, NULL, "pin steps");
+
+        return UART_EINVAL;
+    }
+
+    for (i = 0; i < count; i++) {
+        ret = _uart_set_pins(ctx, uart, steps[i].set, steps[i].clear);
+
+        if (ret != UART_ESUCCESS) {
+            return ret;
+        }
+
+        if (steps[i].delay > 0) {
+            usleep((useconds_t) steps[i].delay * 1000);
+        }
+    }
+
+    return UART_ESUCCESS;
+}
+
+int UART_set_rs485(uart_ctx_t *ctx, uart_t *uart, const struct uart_rs485 *conf)
+{
+    int ret;
+
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+    if (!conf) {
+        _uart_error(ctx, uart, UART_EINVAL, NULL, "RS-485 configuration (NULL)");
+
+        return UART_EINVAL;
+    }
+
+#ifndef LIBUART_THREADS
+    ret = _uart_set_rs485(ctx, uart, conf);
+#else
+    /* don't change the direction control while the TX worker writes */
+    _uart_thread_lock_tx(ctx, uart);
+    ret = _uart_set_rs485(ctx, uart, conf);
+    _uart_thread_unlock_tx(ctx, uart);
 #endif
 
-    return ret;
+    if (ret != UART_ESUCCESS) {
+        return ret;
+    }
+
+    return UART_ESUCCESS;
 }
 
-ssize_t UART_puts(uart_ctx_t *ctx, uart_t *uart, char *msg)
+int UART_get_rs485(uart_ctx_t *ctx, uart_t *uart, struct uart_rs485 *ret_conf)
 {
     if (!ctx) {
         return UART_ECTX;
@@ -650,12 +1784,22 @@ ssize_t UART_puts(uart_ctx_t *ctx, uart_t *uart, char *msg)
         return UART_EHANDLE;
     }
 
-    return UART_send(ctx, uart, msg, strlen(msg));
+    if (!ret_conf) {
+        _uart_error(ctx, uart, UART_EINVAL, NULL, "RS-485 configuration (NULL)");
+
+        return UART_EINVAL;
+    }
+
+    *(ret_conf) = uart->rs485;
+
+    return UART_ESUCCESS;
 }
 
-int UART_putc(uart_ctx_t *ctx, uart_t *uart, char c)
+int UART_set_pin_callback(uart_ctx_t *ctx, uart_t *uart, int mask, uart_pin_cb cb, void *arg)
 {
-    ssize_t ret;
+#ifdef LIBUART_THREADS
+    int ret;
+#endif
 
     if (!ctx) {
         return UART_ECTX;
@@ -667,20 +1811,58 @@ int UART_putc(uart_ctx_t *ctx, uart_t *uart, char c)
         return UART_EHANDLE;
     }
 
-    ret = UART_send(ctx, uart, &c, 1);
+    /* only input pins can be watched */
+    if (mask & (UART_PIN_MASK(UART_PIN_RTS) | UART_PIN_MASK(UART_PIN_DTR))) {
+        _uart_error(ctx, uart, UART_EPIN, NULL, "output pin");
 
-    if (ret != 1) {
+        return UART_EPIN;
+    }
+
+#ifndef LIBUART_THREADS
+    (void) cb;
+    (void) arg;
+    _uart_error(ctx, uart, UART_ENOTSUP, NULL, "requires threading support");
+
+    return UART_ENOTSUP;
+#else
+    ret = _uart_thread_pin_stop(ctx, uart);
+
+    if (ret != UART_ESUCCESS) {
         return ret;
     }
 
-    return UART_ESUCCESS;
+    if (!cb || !mask) {
+        return UART_ESUCCESS;
+    }
+
+    uart->pin_mask = mask;
+    uart->pin_cb = cb;
+    uart->pin_arg = arg;
+
+    return _uart_thread_pin_start(ctx, uart);
+#endif
 }
 
-int UART_getc(uart_ctx_t *ctx, uart_t *uart, char *ret_c)
+int UART_set_pin_signal(uart_ctx_t *ctx, int signum)
 {
-    ssize_t ret;
-    char c[1];
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+#ifndef LIBUART_THREADS
+    (void) signum;
+    _uart_error(ctx, NULL, UART_ENOTSUP, NULL, "requires threading support");
+
+    return UART_ENOTSUP;
+#else
+    return _uart_thread_pin_signal(ctx, signum);
+#endif
+}
+#endif
 
+#ifdef __unix__
+int UART_set_echo_suppress(uart_ctx_t *ctx, uart_t *uart, int enable)
+{
     if (!ctx) {
         return UART_ECTX;
     }
@@ -691,21 +1873,46 @@ int UART_getc(uart_ctx_t *ctx, uart_t *uart, char *ret_c)
         return UART_EHANDLE;
     }
 
-    ret = UART_recv(ctx, uart, c, 1);
+#ifndef LIBUART_THREADS
+    (void) enable;
+    _uart_error(ctx, uart, UART_ENOTSUP, NULL, "requires threading support");
 
-    if (ret != 1) {
-        return ret;
+    return UART_ENOTSUP;
+#else
+    if (!(uart->flags & UART_FOPENED)) {
+        _uart_error(ctx, uart, UART_EDEV, NULL, "not opened");
+
+        return UART_EDEV;
     }
 
-    *(ret_c) = c[0];
+    pthread_mutex_lock(&uart->echo_lock);
+
+    if (enable && !uart->echo_buffer) {
+        uart->echo_buffer = buffer_create(UART_ECHOSIZE);
+
+        if (!uart->echo_buffer) {
+            pthread_mutex_unlock(&uart->echo_lock);
+            _uart_error(ctx, uart, UART_EBUF, NULL, NULL);
+
+            return UART_EBUF;
+        }
+    }
+
+    /* start with an empty echo stream */
+    if (uart->echo_buffer) {
+        buffer_skip(uart->echo_buffer, buffer_get_num(uart->echo_buffer));
+    }
+
+    uart->echo_rec_num = 0;
+    uart->echo = enable ? 1 : 0;
+    pthread_mutex_unlock(&uart->echo_lock);
 
     return UART_ESUCCESS;
+#endif
 }
 
-int UART_flush(uart_ctx_t *ctx, uart_t *uart)
+int UART_set_reconnect(uart_ctx_t *ctx, uart_t *uart, const struct uart_reconnect *policy)
 {
-    int ret;
-
     if (!ctx) {
         return UART_ECTX;
     }
@@ -716,19 +1923,39 @@ int UART_flush(uart_ctx_t *ctx, uart_t *uart)
         return UART_EHANDLE;
     }
 
-    ret = _uart_flush(ctx, uart);
+    if (!policy || (policy->delay_min < 0) || (policy->delay_max < 0) || (policy->max_tries < 0)) {
+        _uart_error(ctx, uart, UART_EINVAL, NULL, "reconnect policy");
 
-    if (ret != UART_ESUCCESS) {
-        return ret;
+        return UART_EINVAL;
     }
 
+#ifndef LIBUART_THREADS
+    _uart_error(ctx, uart, UART_ENOTSUP, NULL, "requires threading support");
+
+    return UART_ENOTSUP;
+#else
+    if (!(uart->flags & UART_FOPENED)) {
+        _uart_error(ctx, uart, UART_EDEV, NULL, "not opened");
+
+        return UART_EDEV;
+    }
+
+    /* the reopen prefers the stable by-id link of the device */
+    if (policy->enable && !(uart->flags & UART_FINFO)) {
+        _uart_get_device_info(ctx, &uart, 1);
+    }
+
+    /* the workers read the policy while holding link_lock */
+    pthread_mutex_lock(&uart->link_lock);
+    uart->reconnect = *(policy);
+    pthread_mutex_unlock(&uart->link_lock);
+
     return UART_ESUCCESS;
+#endif
 }
 
-int UART_set_pin(uart_ctx_t *ctx, uart_t *uart, enum e_pins pin, int state)
+int UART_get_link_state(uart_ctx_t *ctx, uart_t *uart, int *ret_state, unsigned long *ret_reconnects)
 {
-    int ret;
-
     if (!ctx) {
         return UART_ECTX;
     }
@@ -739,19 +1966,36 @@ int UART_set_pin(uart_ctx_t *ctx, uart_t *uart, enum e_pins pin, int state)
         return UART_EHANDLE;
     }
 
-    ret = _uart_set_pin(ctx, uart, pin, state);
+    if (!(uart->flags & UART_FOPENED)) {
+        _uart_error(ctx, uart, UART_EDEV, NULL, "not opened");
 
-    if (ret != UART_ESUCCESS) {
-        return ret;
+        return UART_EDEV;
+    }
+
+#ifndef LIBUART_THREADS
+    /* without workers errors are reported by each call */
+    if (ret_state) {
+        *(ret_state) = UART_LINK_UP;
+    }
+
+    if (ret_reconnects) {
+        *(ret_reconnects) = 0;
+    }
+#else
+    if (ret_state) {
+        *(ret_state) = uart->link_state;
+    }
+
+    if (ret_reconnects) {
+        *(ret_reconnects) = uart->reconnects;
     }
+#endif
 
     return UART_ESUCCESS;
 }
 
-int UART_get_pin(uart_ctx_t *ctx, uart_t *uart, enum e_pins pin, int *ret_state)
+int UART_get_collisions(uart_ctx_t *ctx, uart_t *uart, unsigned long *ret_collisions)
 {
-    int ret;
-
     if (!ctx) {
         return UART_ECTX;
     }
@@ -762,20 +2006,31 @@ int UART_get_pin(uart_ctx_t *ctx, uart_t *uart, enum e_pins pin, int *ret_state)
         return UART_EHANDLE;
     }
 
-    if (!ret_state) {
-        _uart_error(ctx, uart, UART_EINVAL, NULL, "int pointer (NULL)");
+    if (!ret_collisions) {
+        _uart_error(ctx, uart, UART_EINVAL, NULL, "unsigned long pointer (NULL)");
 
         return UART_EINVAL;
     }
 
-    ret = _uart_get_pin(ctx, uart, pin, ret_state);
+#ifndef LIBUART_THREADS
+    _uart_error(ctx, uart, UART_ENOTSUP, NULL, "requires threading support");
 
-    if (ret != UART_ESUCCESS) {
-        return ret;
+    return UART_ENOTSUP;
+#else
+    if (!(uart->flags & UART_FOPENED)) {
+        _uart_error(ctx, uart, UART_EDEV, NULL, "not opened");
+
+        return UART_EDEV;
     }
 
+    pthread_mutex_lock(&uart->echo_lock);
+    *(ret_collisions) = uart->collisions;
+    pthread_mutex_unlock(&uart->echo_lock);
+
     return UART_ESUCCESS;
+#endif
 }
+#endif
 
 int UART_set_baud(uart_ctx_t *ctx, uart_t *uart, enum e_baud baud)
 {
@@ -846,6 +2101,10 @@ int UART_set_databits(uart_ctx_t *ctx, uart_t *uart, enum e_data data_bits)
         return UART_EHANDLE;
     }
 
+    if (multidrop_active(ctx, uart)) {
+        return UART_EINVAL;
+    }
+
     uart->data_bits = data_bits;
     ret = _uart_init_databits(ctx, uart);
 
@@ -893,6 +2152,10 @@ int UART_set_parity(uart_ctx_t *ctx, uart_t *uart, enum e_parity parity)
         return UART_EHANDLE;
     }
 
+    if (multidrop_active(ctx, uart)) {
+        return UART_EINVAL;
+    }
+
     uart->parity = parity;
     ret = _uart_init_parity(ctx, uart);
 
@@ -1093,6 +2356,50 @@ int UART_get_dev(uart_ctx_t *ctx, uart_t *uart, char **ret_dev)
     return UART_ESUCCESS;
 }
 
+#ifdef __unix__
+int UART_get_dev_owner(uart_ctx_t *ctx, const char *devname, int *ret_pid)
+{
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!devname || !ret_pid) {
+        _uart_error(ctx, NULL, UART_EINVAL, NULL, "NULL");
+
+        return UART_EINVAL;
+    }
+
+    return _uart_get_owner(ctx, devname, ret_pid);
+}
+#endif
+
+int UART_get_dev_info(uart_ctx_t *ctx, uart_t *uart, struct uart_dev_info *ret_info)
+{
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+    if (!ret_info) {
+        _uart_error(ctx, uart, UART_EINVAL, NULL, "invalid info (NULL)");
+
+        return UART_EINVAL;
+    }
+
+    if (!(uart->flags & UART_FINFO)) {
+        _uart_get_device_info(ctx, &uart, 1);
+    }
+
+    memcpy(ret_info, &uart->info, sizeof(struct uart_dev_info));
+
+    return UART_ESUCCESS;
+}
+
 int UART_get_bytes_available(uart_ctx_t *ctx, uart_t *uart, int *ret_num)
 {
     int ret;
@@ -1130,6 +2437,125 @@ int UART_get_bytes_available(uart_ctx_t *ctx, uart_t *uart, int *ret_num)
     return UART_ESUCCESS;
 }
 
+#ifdef __unix__
+int UART_get_queue_depth(uart_ctx_t *ctx, uart_t *uart, int *ret_in, int *ret_out)
+{
+    int ret;
+
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+    if (!ret_in || !ret_out) {
+        _uart_error(ctx, uart, UART_EINVAL, NULL, "int pointer (NULL)");
+
+        return UART_EINVAL;
+    }
+
+    ret = _uart_get_queue(ctx, uart, ret_in, ret_out);
+
+    if (ret != UART_ESUCCESS) {
+        return ret;
+    }
+
+    return UART_ESUCCESS;
+}
+#endif
+
+#ifdef __unix__
+int UART_get_counters(uart_ctx_t *ctx, uart_t *uart, struct uart_counters *ret_counters, struct uart_counters *ret_delta)
+{
+    int ret;
+    struct uart_counters counters;
+
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+    if (!ret_counters) {
+        _uart_error(ctx, uart, UART_EINVAL, NULL, "counters pointer (NULL)");
+
+        return UART_EINVAL;
+    }
+
+    ret = _uart_get_counters(ctx, uart, &counters);
+
+    if (ret != UART_ESUCCESS) {
+        return ret;
+    }
+
+    /* the kernel counters are 32 bit wide, so is the difference */
+    if (ret_delta) {
+        ret_delta->rx = (unsigned int) (counters.rx - uart->counters.rx);
+        ret_delta->tx = (unsigned int) (counters.tx - uart->counters.tx);
+        ret_delta->frame = (unsigned int) (counters.frame - uart->counters.frame);
+        ret_delta->overrun = (unsigned int) (counters.overrun - uart->counters.overrun);
+        ret_delta->parity = (unsigned int) (counters.parity - uart->counters.parity);
+        ret_delta->brk = (unsigned int) (counters.brk - uart->counters.brk);
+        ret_delta->buf_overrun = (unsigned int) (counters.buf_overrun - uart->counters.buf_overrun);
+    }
+
+    uart->counters = counters;
+    *(ret_counters) = counters;
+
+    return UART_ESUCCESS;
+}
+#endif
+
+#ifdef __unix__
+int UART_get_flow_stats(uart_ctx_t *ctx, uart_t *uart, struct uart_flow_stats *ret_stats)
+{
+    if (!ctx) {
+        return UART_ECTX;
+    }
+
+    if (!uart) {
+        _uart_error(ctx, NULL, UART_EHANDLE, NULL, "NULL");
+
+        return UART_EHANDLE;
+    }
+
+    if (!ret_stats) {
+        _uart_error(ctx, uart, UART_EINVAL, NULL, "flow statistics pointer (NULL)");
+
+        return UART_EINVAL;
+    }
+
+    /* a stop may have ended (or started) after the last send */
+#ifdef LIBUART_THREADS
+    _uart_thread_lock_tx(ctx, uart);
+    _uart_flow_update(ctx, uart, buffer_get_num(uart->tx_buffer) > 0);
+#else
+    _uart_flow_update(ctx, uart, 0);
+#endif
+
+    *(ret_stats) = uart->flow;
+
+    /* include a currently running stop */
+    if (uart->flow.blocked) {
+        ret_stats->blocked_ms += time_get_ms() - uart->flow_since;
+    }
+
+#ifdef LIBUART_THREADS
+    _uart_thread_unlock_tx(ctx, uart);
+#endif
+
+    return UART_ESUCCESS;
+}
+#endif
+
 int UART_get_deverrro(uart_ctx_t *ctx, uart_t *uart)
 {
     if (!ctx) {
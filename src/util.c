@@ -23,6 +23,12 @@
 #include <stddef.h>
 #include <string.h>
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
 int enum_contains(int enum_values[], int len, int value)
 {
     int i;
@@ -69,3 +75,16 @@ int strnrcmp(const char *str1, const char *str2, size_t num)
 
     return 0;
 }
+
+long long time_get_ms(void)
+{
+#ifdef _WIN32
+    return (long long) GetTickCount64();
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((long long) ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+#endif
+}
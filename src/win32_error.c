@@ -592,6 +592,78 @@ void _uart_error(struct _uart_ctx *ctx,
                     }
                 }
 
+                break;
+            case UART_ETIMEOUT:
+                if (error_func) {
+                    if (error_msg) {
+                        snprintf(uart->errormsg, UART_ERRORMAX,
+                                 "%s: operation timed out (%s)",
+                                 error_func,
+                                 error_msg);
+                    } else {
+                        snprintf(uart->errormsg, UART_ERRORMAX,
+                                 "%s: operation timed out",
+                                 error_func);
+                    }
+                } else {
+                    if (error_msg) {
+                        snprintf(uart->errormsg, UART_ERRORMAX,
+                                 "operation timed out (%s)",
+                                 error_msg);
+                    } else {
+                        snprintf(uart->errormsg, UART_ERRORMAX,
+                                 "operation timed out");
+                    }
+                }
+
+                break;
+            case UART_EBUSY:
+                if (error_func) {
+                    if (error_msg) {
+                        snprintf(uart->errormsg, UART_ERRORMAX,
+                                 "%s: device busy (%s)",
+                                 error_func,
+                                 error_msg);
+                    } else {
+                        snprintf(uart->errormsg, UART_ERRORMAX,
+                                 "%s: device busy",
+                                 error_func);
+                    }
+                } else {
+                    if (error_msg) {
+                        snprintf(uart->errormsg, UART_ERRORMAX,
+                                 "device busy (%s)",
+                                 error_msg);
+                    } else {
+                        snprintf(uart->errormsg, UART_ERRORMAX,
+                                 "device busy");
+                    }
+                }
+
+                break;
+            case UART_ENOTSUP:
+                if (error_func) {
+                    if (error_msg) {
+                        snprintf(uart->errormsg, UART_ERRORMAX,
+                                 "%s: operation not supported (%s)",
+                                 error_func,
+                                 error_msg);
+                    } else {
+                        snprintf(uart->errormsg, UART_ERRORMAX,
+                                 "%s: operation not supported",
+                                 error_func);
+                    }
+                } else {
+                    if (error_msg) {
+                        snprintf(uart->errormsg, UART_ERRORMAX,
+                                 "operation not supported (%s)",
+                                 error_msg);
+                    } else {
+                        snprintf(uart->errormsg, UART_ERRORMAX,
+                                 "operation not supported");
+                    }
+                }
+
                 break;
             default:
                 if (error_func) {
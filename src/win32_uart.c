@@ -78,6 +78,8 @@
 #define WIN_PARITY_NONE             0x0100
 #define WIN_PARITY_ODD              0x0200
 #define WIN_PARITY_EVEN             0x0400
+#define WIN_PARITY_MARK             0x0800
+#define WIN_PARITY_SPACE            0x1000
 
 #define WIN_UART_MAX                512
 
@@ -360,6 +362,24 @@ int _uart_init_parity(struct _uart_ctx *ctx, struct _uart *uart)
         
         dcb.Parity = EVENPARITY;
         break;
+    case UART_PARITY_MARK:
+        if (!(uart->prop.wSettableStopParity & WIN_PARITY_MARK)) {
+            _uart_error(ctx, uart, UART_EPARITY, NULL, "unsupported");
+
+            return UART_EPARITY;
+        }
+        
+        dcb.Parity = MARKPARITY;
+        break;
+    case UART_PARITY_SPACE:
+        if (!(uart->prop.wSettableStopParity & WIN_PARITY_SPACE)) {
+            _uart_error(ctx, uart, UART_EPARITY, NULL, "unsupported");
+
+            return UART_EPARITY;
+        }
+        
+        dcb.Parity = SPACEPARITY;
+        break;
     default:
         _uart_error(ctx, uart, UART_EPARITY, NULL, "unsupported");
 
@@ -539,24 +559,35 @@ int _uart_get_device_list(struct _uart_ctx *ctx)
                        NULL);
 
         if (h != INVALID_HANDLE_VALUE) {
-            ctx->uarts[ctx->uarts_count] = (struct _uart *) malloc(sizeof(struct _uart));
-
-            if (!ctx->uarts[ctx->uarts_count]) {
-                _uart_error(ctx, NULL, UART_ENOMEM, NULL, NULL);
+            CloseHandle(h);
 
+            if (_uart_device_found(ctx, devname) != UART_ESUCCESS) {
                 return UART_ENOMEM;
             }
-
-            memset(ctx->uarts[ctx->uarts_count], 0, sizeof(struct _uart));
-            strcpy(ctx->uarts[ctx->uarts_count]->dev, devname);
-            ctx->uarts_count++;
-            CloseHandle(h);
         }
     }
 
     return UART_ESUCCESS;
 }
 
+void _uart_get_device_info(struct _uart_ctx *ctx, struct _uart **uarts, int count)
+{
+    int i;
+
+    if (!ctx) {
+        return;
+    }
+
+    /* no identity sources are queried on Windows yet */
+    for (i = 0; i < count; i++) {
+        memset(&uarts[i]->info, 0, sizeof(struct uart_dev_info));
+        uarts[i]->info.vid = UART_INFO_ANY;
+        uarts[i]->info.pid = UART_INFO_ANY;
+        uarts[i]->info.interface = UART_INFO_ANY;
+        uarts[i]->flags |= UART_FINFO;
+    }
+}
+
 int _uart_open(struct _uart_ctx *ctx, struct _uart *uart)
 {
     int ret;